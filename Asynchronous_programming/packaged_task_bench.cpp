@@ -0,0 +1,47 @@
+#include <future>
+#include <thread>
+#include "benchmark.h"
+
+/*
+ * Cost of the future-based primitives
+ *
+ * - promise/future: set_value() then get() in the same thread
+ * - packaged_task: invoke in the same thread, then get()
+ * - packaged_task on a new thread: the same, but the task is the thread's entry point
+ * - promise/future between threads: a producer thread sets the value, this thread gets it
+ *      */
+
+int main(int argc, char *argv[])
+{
+    bench::add("promise_future/same_thread", [](bench::context &) {
+        std::promise<int> prom;
+        auto fut = prom.get_future();
+        prom.set_value(42);
+        bench::do_not_optimize(fut.get());
+    });
+
+    bench::add("packaged_task/same_thread", [](bench::context &) {
+        std::packaged_task<int(int, int)> ptask([](int a, int b) { return a + b; });
+        auto fut = ptask.get_future();
+        ptask(6, 7);
+        bench::do_not_optimize(fut.get());
+    });
+
+    bench::add("packaged_task/new_thread", [](bench::context &) {
+        std::packaged_task<int(int, int)> ptask([](int a, int b) { return a + b; });
+        auto fut = ptask.get_future();
+        std::thread thr(std::move(ptask), 6, 7);
+        bench::do_not_optimize(fut.get());
+        thr.join();
+    });
+
+    bench::add("promise_future/producer_thread", [](bench::context &) {
+        std::promise<int> prom;
+        auto fut = prom.get_future();
+        std::thread producer([&prom] { prom.set_value(7 + 8); });
+        bench::do_not_optimize(fut.get());
+        producer.join();
+    });
+
+    return bench::run(argc, argv);
+}
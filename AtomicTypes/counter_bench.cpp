@@ -0,0 +1,33 @@
+#include <atomic>
+#include "sharded_counter.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Single atomic counter vs sharded counter
+ *
+ * - atomic_counter: every thread does fetch_add() on one std::atomic<int>
+ *      - The baseline from main.cpp
+ * - sharded_counter: every thread adds to the shard for its CPU
+ * - sharded_counter/read: the cost of adding up the shards
+ *      */
+
+padded<std::atomic<int>> atomic_counter{0};
+sharded_counter<int> sharded;
+
+int main(int argc, char *argv[])
+{
+    bench::add("atomic_counter/fetch_add", [](bench::context &) {
+        atomic_counter->fetch_add(1);
+    }).threads_range(bench::hardware_threads());
+
+    bench::add("sharded_counter/add", [](bench::context &) {
+        sharded.add(1);
+    }).threads_range(bench::hardware_threads());
+
+    bench::add("sharded_counter/read", [](bench::context &) {
+        bench::do_not_optimize(sharded.read());
+    });
+
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,51 @@
+#include <atomic>
+#include <iostream>
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * False sharing benchmark
+ *
+ * - Each thread increments its own counter - there is no logical sharing
+ * - adjacent: the counters are next to each other in one array
+ *      - Up to 8 counters in each cache line
+ * - padded: each counter is a padded<std::atomic<long long>>
+ * - per_thread_array: each thread uses its own slot via local()
+ *
+ * - With one thread the three should be the same
+ * - With more threads, adjacent slows down as the cache line bounces between cores
+ *      */
+
+constexpr int max_threads = 256;
+
+struct {
+    std::atomic<long long> counters[max_threads];
+} adjacent;
+
+padded<std::atomic<long long>> separate[max_threads];
+
+per_thread_array<std::atomic<long long>> per_thread(max_threads);
+
+int main(int argc, char *argv[])
+{
+    std::cout << "adjacent counters share a cache line: " << std::boolalpha
+              << shares_cache_line(&adjacent.counters[0], &adjacent.counters[1]) << std::endl;
+    std::cout << "padded counters share a cache line: "
+              << shares_cache_line(&separate[0], &separate[1]) << std::endl;
+
+    const int threads = std::min(bench::hardware_threads(), max_threads);
+
+    bench::add("adjacent", [](bench::context &ctx) {
+        adjacent.counters[ctx.thread_index].fetch_add(1, std::memory_order_relaxed);
+    }).threads_range(threads);
+
+    bench::add("padded", [](bench::context &ctx) {
+        separate[ctx.thread_index]->fetch_add(1, std::memory_order_relaxed);
+    }).threads_range(threads);
+
+    bench::add("per_thread_array", [](bench::context &) {
+        per_thread.local().fetch_add(1, std::memory_order_relaxed);
+    }).threads_range(threads);
+
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include "sharded_counter.h"
+#include "padded.h"
+
+/*
+ * Atomic Types
+ *
+ * - The <atomic> header defines std::atomic<T>
+ *      - All operations on the object are atomic
+ *      - T must be trivially copyable
+ *
+ * - Integer types, pointers and (since C++20) floating point have specializations
+ *      - std::atomic<int> x = 0;
+ *      - ++x is a single atomic read-modify-write
+ *      - With a plain int, ++x is load, add, store - and another thread can interleave
+ *      */
+
+/*
+ * Atomic Types and Performance
+ *
+ * - An atomic operation is much slower than the non-atomic version
+ *      - The processor must get exclusive ownership of the cache line
+ * - If many threads update the same atomic, the cache line "ping-pongs" between cores
+ *      - The threads are effectively serialized
+ *
+ * - sharded_counter (sharded_counter.h)
+ *      - One counter per CPU, each in its own cache line
+ *      - add() is cheap, read() adds up the shards
+ *
+ * - Hot atomics get a cache line of their own (padded.h)
+ *      - Otherwise atomic_counter could share a line with mut or counter
+ *      */
+
+// Plain int - data race
+int counter = 0;
+
+// Atomic int - no data race
+padded<std::atomic<int>> atomic_counter{0};
+
+// Sharded atomic counter - no data race, and no contention on one cache line
+sharded_counter<int> sharded;
+
+std::mutex mut;
+
+void task()
+{
+    for (int i = 0; i < 100'000; ++i)
+        ++counter;
+}
+
+void atomic_task()
+{
+    for (int i = 0; i < 100'000; ++i)
+        ++*atomic_counter;
+}
+
+void sharded_task()
+{
+    for (int i = 0; i < 100'000; ++i)
+        ++sharded;
+}
+
+// Atomic pointer - the pointer itself is atomic, not the object it points to
+padded<std::atomic<int *>> atomic_ptr{nullptr};
+int value = 42;
+
+void assignment_task()
+{
+    *atomic_ptr = &value;
+
+    std::lock_guard<std::mutex> lg(mut);
+    std::cout << "pointer has been initialized" << std::endl;
+}
+
+int main() {
+    std::cout << "Hello, World!" << std::endl;
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 10; ++i)
+        threads.push_back(std::thread(task));
+    for (auto &thr : threads)
+        thr.join();
+    threads.clear();
+
+    for (int i = 0; i < 10; ++i)
+        threads.push_back(std::thread(atomic_task));
+    for (auto &thr : threads)
+        thr.join();
+    threads.clear();
+
+    for (int i = 0; i < 10; ++i)
+        threads.push_back(std::thread(sharded_task));
+    for (auto &thr : threads)
+        thr.join();
+    threads.clear();
+
+    std::cout << "counter = " << counter << std::endl;
+    std::cout << "atomic_counter = " << *atomic_counter << std::endl;
+    std::cout << "sharded counter = " << sharded.read() << std::endl;
+
+    std::thread thr(assignment_task);
+    thr.join();
+    std::cout << "*atomic_ptr = " << *atomic_ptr->load() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <atomic>
+#include <string>
+#include "ordered_atomic.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Memory order benchmark
+ *
+ * - Every operation from the atomic_counter and lock_cout examples
+ *      - load, store, exchange, compare_exchange_weak/strong, fetch_add
+ *      - atomic_flag test_and_set() + clear(), as used by the spin lock
+ * - Compiled once for each memory order, run with 1, 2, 4 ... threads
+ *
+ * - On x86, only seq_cst stores (and fences) cost extra
+ *      - Every read-modify-write is a locked instruction whatever the ordering
+ * - On weakly ordered hardware (ARM, POWER) the weaker orderings save barriers
+ *
+ * - Configure with -DATOMIC_TYPES_TSAN=ON to build under ThreadSanitizer
+ *      - TSan models the weaker orderings, so it reports races that x86 hides
+ *      */
+
+template<std::memory_order Order>
+void add_benchmarks()
+{
+    static padded<ordered_atomic<long long, Order>> value{0};
+    static padded<ordered_flag<Order>> flag;
+    const std::string suffix = std::string("/") + order_name(Order);
+    const int threads = bench::hardware_threads();
+
+    bench::add("load" + suffix, [](bench::context &) {
+        bench::do_not_optimize(value->load());
+    }).threads_range(threads);
+
+    bench::add("store" + suffix, [](bench::context &ctx) {
+        value->store(ctx.thread_index);
+    }).threads_range(threads);
+
+    bench::add("exchange" + suffix, [](bench::context &ctx) {
+        bench::do_not_optimize(value->exchange(ctx.thread_index));
+    }).threads_range(threads);
+
+    bench::add("compare_exchange_weak" + suffix, [](bench::context &) {
+        long long expected = value->load();
+        while (!value->compare_exchange_weak(expected, expected + 1)) {}
+    }).threads_range(threads);
+
+    bench::add("compare_exchange_strong" + suffix, [](bench::context &) {
+        long long expected = value->load();
+        while (!value->compare_exchange_strong(expected, expected + 1)) {}
+    }).threads_range(threads);
+
+    bench::add("fetch_add" + suffix, [](bench::context &) {
+        value->fetch_add(1);
+    }).threads_range(threads);
+
+    bench::add("flag_test_and_set_clear" + suffix, [](bench::context &) {
+        while (flag->test_and_set()) {}
+        flag->clear();
+    }).threads_range(threads);
+}
+
+int main(int argc, char *argv[])
+{
+    add_benchmarks<std::memory_order_relaxed>();
+    add_benchmarks<std::memory_order_acquire>();
+    add_benchmarks<std::memory_order_release>();
+    add_benchmarks<std::memory_order_acq_rel>();
+    add_benchmarks<std::memory_order_seq_cst>();
+    return bench::run(argc, argv);
+}
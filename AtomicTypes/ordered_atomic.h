@@ -0,0 +1,134 @@
+#ifndef ORDERED_ATOMIC_H
+#define ORDERED_ATOMIC_H
+
+#include <atomic>
+
+/*
+ * Memory Order
+ *
+ * - Every operation on std::atomic takes an optional std::memory_order
+ *      - The default is std::memory_order_seq_cst, the strongest
+ *
+ * - memory_order_relaxed
+ *      - The operation is atomic, but does not order any other memory access
+ * - memory_order_acquire (loads)
+ *      - Reads and writes after the load cannot be moved before it
+ * - memory_order_release (stores)
+ *      - Reads and writes before the store cannot be moved after it
+ * - memory_order_acq_rel (read-modify-write)
+ *      - Both acquire and release
+ * - memory_order_seq_cst
+ *      - acq_rel, plus a single total order of all seq_cst operations
+ *      - On x86, a seq_cst store needs a full fence (or xchg)
+ *
+ * - ordered_atomic<T, Order> applies one ordering to every operation
+ *      - So the same code can be compiled with each ordering and benchmarked
+ *      - Loads cannot be release and stores cannot be acquire
+ *        Each operation uses the strongest ordering which is legal for it
+ *          ordered_atomic<int, std::memory_order_acq_rel> x;
+ *          x.load();           // acquire
+ *          x.store(1);         // release
+ *          x.fetch_add(1);     // acq_rel
+ *      */
+
+// The strongest ordering, no stronger than order, which a load can use
+constexpr std::memory_order load_order(std::memory_order order)
+{
+    if (order == std::memory_order_release)
+        return std::memory_order_relaxed;
+    if (order == std::memory_order_acq_rel)
+        return std::memory_order_acquire;
+    return order;
+}
+
+// The strongest ordering, no stronger than order, which a store can use
+constexpr std::memory_order store_order(std::memory_order order)
+{
+    if (order == std::memory_order_acquire || order == std::memory_order_consume)
+        return std::memory_order_relaxed;
+    if (order == std::memory_order_acq_rel)
+        return std::memory_order_release;
+    return order;
+}
+
+constexpr const char *order_name(std::memory_order order)
+{
+    switch (order) {
+        case std::memory_order_relaxed: return "relaxed";
+        case std::memory_order_consume: return "consume";
+        case std::memory_order_acquire: return "acquire";
+        case std::memory_order_release: return "release";
+        case std::memory_order_acq_rel: return "acq_rel";
+        case std::memory_order_seq_cst: return "seq_cst";
+    }
+    return "unknown";
+}
+
+template<typename T, std::memory_order Order = std::memory_order_seq_cst>
+class ordered_atomic {
+public:
+    static constexpr std::memory_order order = Order;
+
+    constexpr ordered_atomic(T desired = T()) noexcept : value(desired) {}
+
+    ordered_atomic(const ordered_atomic &) = delete;
+    ordered_atomic &operator=(const ordered_atomic &) = delete;
+
+    T load() const noexcept { return value.load(load_order(Order)); }
+    void store(T desired) noexcept { value.store(desired, store_order(Order)); }
+
+    operator T() const noexcept { return load(); }
+    T operator=(T desired) noexcept { store(desired); return desired; }
+
+    T exchange(T desired) noexcept { return value.exchange(desired, Order); }
+
+    bool compare_exchange_weak(T &expected, T desired) noexcept
+    {
+        return value.compare_exchange_weak(expected, desired, Order, load_order(Order));
+    }
+
+    bool compare_exchange_strong(T &expected, T desired) noexcept
+    {
+        return value.compare_exchange_strong(expected, desired, Order, load_order(Order));
+    }
+
+    T fetch_add(T arg) noexcept { return value.fetch_add(arg, Order); }
+    T fetch_sub(T arg) noexcept { return value.fetch_sub(arg, Order); }
+    T fetch_and(T arg) noexcept { return value.fetch_and(arg, Order); }
+    T fetch_or(T arg) noexcept { return value.fetch_or(arg, Order); }
+    T fetch_xor(T arg) noexcept { return value.fetch_xor(arg, Order); }
+
+    T operator++() noexcept { return fetch_add(1) + 1; }
+    T operator++(int) noexcept { return fetch_add(1); }
+    T operator--() noexcept { return fetch_sub(1) - 1; }
+    T operator--(int) noexcept { return fetch_sub(1); }
+
+    void wait(T old) const noexcept { value.wait(old, load_order(Order)); }
+    void notify_one() noexcept { value.notify_one(); }
+    void notify_all() noexcept { value.notify_all(); }
+
+    bool is_lock_free() const noexcept { return value.is_lock_free(); }
+
+private:
+    std::atomic<T> value;
+};
+
+// std::atomic_flag with one ordering for every operation
+// ordered_flag<std::memory_order_acq_rel> is the usual spin lock flag:
+// test_and_set() acquires, clear() releases
+template<std::memory_order Order = std::memory_order_seq_cst>
+class ordered_flag {
+public:
+    bool test_and_set() noexcept { return flag.test_and_set(Order); }
+    bool test() const noexcept { return flag.test(load_order(Order)); }
+    void clear() noexcept { flag.clear(store_order(Order)); }
+
+    void wait(bool old) const noexcept { flag.wait(old, load_order(Order)); }
+    void notify_one() noexcept { flag.notify_one(); }
+    void notify_all() noexcept { flag.notify_all(); }
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+#endif //ORDERED_ATOMIC_H
@@ -0,0 +1,119 @@
+#ifndef PADDED_H
+#define PADDED_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/*
+ * False Sharing
+ *
+ * - The processor moves data between cores one cache line at a time (64 bytes on x86)
+ * - Two atomics in the same cache line are not independent
+ *      - A write to one takes the whole line away from every other core
+ *      - Threads updating "their own" variable still contend with each other
+ *
+ * - The linker puts globals wherever it likes
+ *      - e.g. lock_cout may share a cache line with mut
+ *
+ * - Fix: give each hot variable a cache line of its own
+ *      - padded<T> wraps any type in its own cache line, and fills the rest of it
+ *      - alignas(cache_line_size) on a variable is not enough: it only aligns where the variable starts,
+ *        and the next global can still be put in the same line
+ *      - alignas(cache_line_size) on a type is enough, because it also rounds sizeof up to a whole line
+ *      - per_thread_array<T> gives each thread its own padded slot
+ *
+ * - Detecting it
+ *      - shares_cache_line(&a, &b) checks two objects at run time
+ *      - false_sharing_bench shows the cost
+ *
+ * - cache_line_size
+ *      - C++17 has std::hardware_destructive_interference_size
+ *      - GCC warns that its value depends on -mtune, so headers use a fixed constant
+ *      */
+
+constexpr std::size_t cache_line_size = 64;
+
+template<typename T>
+struct alignas(cache_line_size) padded {
+    T value;
+
+    template<typename... Args>
+        requires std::is_constructible_v<T, Args...>
+    constexpr padded(Args &&...args) : value(std::forward<Args>(args)...) {}
+
+    T &operator*() noexcept { return value; }
+    const T &operator*() const noexcept { return value; }
+    T *operator->() noexcept { return &value; }
+    const T *operator->() const noexcept { return &value; }
+};
+
+static_assert(sizeof(padded<std::atomic<int>>) == cache_line_size);
+static_assert(alignof(padded<std::atomic<int>>) == cache_line_size);
+
+// Do any bytes of the two objects lie in the same cache line?
+template<typename T, typename U>
+bool shares_cache_line(const T *a, const U *b) noexcept
+{
+    auto first_line = [](const void *p) { return reinterpret_cast<std::uintptr_t>(p) / cache_line_size; };
+    auto last_line = [](const void *p, std::size_t size) {
+        return (reinterpret_cast<std::uintptr_t>(p) + size - 1) / cache_line_size;
+    };
+    return first_line(a) <= last_line(b, sizeof(U)) && first_line(b) <= last_line(a, sizeof(T));
+}
+
+// A small number for each thread: 0, 1, 2 ... in the order threads first call it
+inline std::size_t thread_slot() noexcept
+{
+    static std::atomic<std::size_t> next{0};
+    thread_local std::size_t slot = next.fetch_add(1, std::memory_order_relaxed);
+    return slot;
+}
+
+// One padded slot for each thread
+// With more threads than slots, threads share slots, so T must be thread-safe (e.g. atomic)
+template<typename T>
+class per_thread_array {
+public:
+    explicit per_thread_array(std::size_t n = default_size()) : n_slots(std::max<std::size_t>(1, n)),
+                                                                slots(new padded<T>[n_slots]) {}
+
+    T &local() noexcept { return slots[thread_slot() % n_slots].value; }
+
+    T &operator[](std::size_t i) noexcept { return slots[i].value; }
+    const T &operator[](std::size_t i) const noexcept { return slots[i].value; }
+
+    std::size_t size() const noexcept { return n_slots; }
+
+    // Visit every slot, e.g. to add up per-thread counters
+    template<typename Func>
+    void for_each(Func func) const
+    {
+        for (std::size_t i = 0; i < n_slots; ++i)
+            func(slots[i].value);
+    }
+
+    template<typename Func>
+    void for_each(Func func)
+    {
+        for (std::size_t i = 0; i < n_slots; ++i)
+            func(slots[i].value);
+    }
+
+    static std::size_t default_size()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+private:
+    std::size_t n_slots;
+    std::unique_ptr<padded<T>[]> slots;
+};
+
+#endif //PADDED_H
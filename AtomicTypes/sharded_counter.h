@@ -0,0 +1,97 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include "padded.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/*
+ * Sharded Counter
+ *
+ * - A single std::atomic<int> counter is one cache line
+ *      - Every fetch_add() must own that cache line
+ *      - With many threads, the line moves from core to core on every increment
+ *      - The threads are serialized, however many cores we have
+ *
+ * - Split the counter into shards, one per CPU
+ *      - Each shard is in its own cache line (padded.h)
+ *      - add() only touches the shard for the CPU it is running on
+ *      - Usually no other core is using that line, so fetch_add() is cheap
+ *
+ * - read() adds up all the shards
+ *      - More expensive, so use it when writes are much more common than reads
+ *      - Not a snapshot: adds made while read() runs may or may not be included
+ *      */
+
+template<typename T = long long>
+class sharded_counter {
+public:
+    explicit sharded_counter(unsigned n_shards = default_shards())
+            : mask(round_up_pow2(n_shards) - 1), shards(new padded<std::atomic<T>>[mask + 1]) {}
+
+    void add(T n = 1) noexcept
+    {
+        shards[shard_index() & mask].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    void sub(T n = 1) noexcept { add(-n); }
+
+    sharded_counter &operator++() noexcept { add(1); return *this; }
+    sharded_counter &operator+=(T n) noexcept { add(n); return *this; }
+
+    T read() const noexcept
+    {
+        T total = 0;
+        for (std::size_t i = 0; i <= mask; ++i)
+            total += shards[i].value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    operator T() const noexcept { return read(); }
+
+    // Not atomic with respect to concurrent add() calls
+    void reset() noexcept
+    {
+        for (std::size_t i = 0; i <= mask; ++i)
+            shards[i].value.store(0, std::memory_order_relaxed);
+    }
+
+    std::size_t shard_count() const noexcept { return mask + 1; }
+
+    static unsigned default_shards()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+private:
+    static std::size_t round_up_pow2(std::size_t n)
+    {
+        std::size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    // The CPU we are running on. If that is not available, give each thread its own slot
+    static std::size_t shard_index() noexcept
+    {
+#ifdef __linux__
+        int cpu = sched_getcpu();
+        if (cpu >= 0)
+            return static_cast<std::size_t>(cpu);
+#endif
+        return thread_slot();
+    }
+
+    std::size_t mask;
+    std::unique_ptr<padded<std::atomic<T>>[]> shards;
+};
+
+#endif //SHARDED_COUNTER_H
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <list>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "concurrent_arena.h"
+#include "rw_spin_lock.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * concurrent_arena benchmark
+ *
+ * - Check first: threads fill blocks from the arena with their own pattern - no two blocks may overlap
+ *
+ * - Then the cost of one "request"
+ *      - Build a vector of 64 ints (several reallocations) and a list of 16 ints
+ *      - new/delete: std::vector and std::list with the default allocator
+ *      - monotonic: a std::pmr::monotonic_buffer_resource for each request
+ *      - arena: one shared concurrent_arena through arena_resource
+ *
+ * - The arena is reset between batches of requests
+ *      - Requests hold a shared lock on an rw_spin_lock
+ *      - When the arena is half full, the next request takes the lock exclusively and resets it
+ *      - So reset() only runs when no request is in progress
+ *      */
+
+bool check()
+{
+    concurrent_arena arena(16 << 20, 4096);
+    constexpr int n_threads = 4;
+    constexpr int n_blocks = 2000;
+    std::vector<std::vector<unsigned char *>> blocks(n_threads);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < n_blocks; ++i) {
+                std::size_t n = 1 + (i * 37) % 1500;        // Some bigger than a quarter chunk
+                auto *p = static_cast<unsigned char *>(arena.allocate(n, 8));
+                for (std::size_t k = 0; k < n; ++k)
+                    p[k] = static_cast<unsigned char>(t + 1);
+                blocks[t].push_back(p);
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    for (int t = 0; t < n_threads; ++t) {
+        for (int i = 0; i < n_blocks; ++i) {
+            std::size_t n = 1 + (i * 37) % 1500;
+            for (std::size_t k = 0; k < n; ++k) {
+                if (blocks[t][i][k] != t + 1)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+constexpr std::size_t arena_size = 4 << 20;
+concurrent_arena arena(arena_size);
+arena_resource resource(arena);
+padded<rw_spin_lock> batch_lock;
+
+template<typename Vector, typename List>
+int handle_request(Vector &v, List &l, int seed)
+{
+    for (int i = 0; i < 64; ++i)
+        v.push_back(seed + i);
+    for (int i = 0; i < 16; ++i)
+        l.push_back(seed - i);
+    return v.back() + l.back();
+}
+
+int main(int argc, char *argv[])
+{
+    if (!check()) {
+        std::printf("check: FAILED\n");
+        return 1;
+    }
+    std::printf("check: ok\n");
+
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("new_delete/request", [](bench::context &ctx) {
+        std::vector<int> v;
+        std::list<int> l;
+        bench::do_not_optimize(handle_request(v, l, ctx.thread_index));
+    }).threads(thread_counts);
+
+    bench::add("monotonic/request", [](bench::context &ctx) {
+        std::pmr::monotonic_buffer_resource mono;
+        std::pmr::vector<int> v(&mono);
+        std::pmr::list<int> l(&mono);
+        bench::do_not_optimize(handle_request(v, l, ctx.thread_index));
+    }).threads(thread_counts);
+
+    bench::add("arena/request", [](bench::context &ctx) {
+        // End of a batch: wait for the requests in progress, then reuse the arena
+        if (arena.used() > arena_size / 2) {
+            std::lock_guard<rw_spin_lock> lg(*batch_lock);
+            if (arena.used() > arena_size / 2)
+                arena.reset();
+        }
+        std::shared_lock<rw_spin_lock> sl(*batch_lock);
+        std::pmr::vector<int> v(&resource);
+        std::pmr::list<int> l(&resource);
+        bench::do_not_optimize(handle_request(v, l, ctx.thread_index));
+    }).threads(thread_counts).setup([](int) { arena.reset(); });
+
+    return bench::run(argc, argv);
+}
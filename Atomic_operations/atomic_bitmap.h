@@ -0,0 +1,175 @@
+#ifndef ATOMIC_BITMAP_H
+#define ATOMIC_BITMAP_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include "padded.h"
+
+/*
+ * Atomic Bitmap Allocator
+ *
+ * - Integer atomics have fetch_or(), fetch_and() and fetch_xor()
+ *      - Each returns the old value, so a thread can set one bit and know whether it was already set
+ *      - That is enough to hand out slot numbers in a fixed-size table with no lock
+ *        (worker slots, hazard pointer records, connection ids ...)
+ *
+ * - One bit per slot, 64 slots per word
+ *      - allocate(): find a zero bit with std::countr_one(), then fetch_or() it
+ *          - If the old value already had the bit, another thread won - try the next zero bit
+ *      - release(): fetch_and() the bit back to zero
+ *
+ * - With millions of slots, searching every word for a zero bit is too slow when the table fills up
+ *      - A summary level has one bit per word: set means "this word is full"
+ *      - One summary word skips 64 full words (4096 slots) with one std::countr_one()
+ *
+ * - Keeping the summary right
+ *      - The thread which fills a word sets its summary bit, then checks the word again:
+ *        if a slot was released meanwhile, it clears the summary bit
+ *      - The thread which releases a slot in a full word clears its summary bit
+ *      - A summary bit can say "not full" for a full word for a moment - allocate() then
+ *        finds the word full, and sets the bit itself
+ *
+ * - Each thread starts searching where it last found a free slot
+ *      - Threads start in different places, so they do not all fetch_or() the same word
+ *      - Allocation is O(1) amortized: full parts of the table are skipped 4096 slots at a time,
+ *        and a thread only moves its start point forward past them once
+ *      - Within a word, the lowest free slot is used - small tables stay dense
+ *
+ * - allocate() returns nothing when every slot is in use
+ *      - It may also return nothing if a slot is released while the search is in progress
+ *
+ *          atomic_bitmap slots(1 << 20);
+ *          if (auto i = slots.allocate()) {
+ *              table[*i] = ...;
+ *              slots.release(*i);
+ *          }
+ *      */
+
+class atomic_bitmap {
+public:
+    explicit atomic_bitmap(std::size_t capacity)
+        : n_slots(capacity),
+          n_words(std::max<std::size_t>(1, (capacity + 63) / 64)),
+          n_summary((n_words + 63) / 64),
+          words(new std::atomic<std::uint64_t>[n_words]()),
+          summary(new std::atomic<std::uint64_t>[n_summary]())
+    {
+        // Bits past the end are permanently in use
+        words[n_words - 1].store(padding(n_slots - (n_words - 1) * 64), std::memory_order_relaxed);
+        summary[n_summary - 1].store(padding(n_words - (n_summary - 1) * 64), std::memory_order_relaxed);
+        if (words[n_words - 1].load(std::memory_order_relaxed) == full)
+            summary[n_summary - 1].fetch_or(summary_bit(n_words - 1), std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < hints.size(); ++i)
+            hints[i].store(i * n_summary / hints.size(), std::memory_order_relaxed);
+    }
+
+    atomic_bitmap(const atomic_bitmap &) = delete;
+    atomic_bitmap &operator=(const atomic_bitmap &) = delete;
+
+    // A free slot, now in use by the caller - or nothing if the bitmap is full
+    std::optional<std::size_t> allocate() noexcept
+    {
+        auto &hint = hints.local();
+        auto start = hint.load(std::memory_order_relaxed);
+
+        for (std::size_t k = 0; k < n_summary; ++k) {
+            auto s = start + k < n_summary ? start + k : start + k - n_summary;
+            auto skip = summary[s].load(std::memory_order_acquire);
+            while (skip != full) {
+                auto w = s * 64 + std::countr_one(skip);
+                if (auto slot = claim(w)) {
+                    if (s != start)
+                        hint.store(s, std::memory_order_relaxed);
+                    return slot;
+                }
+                skip |= summary_bit(w);
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Give back a slot from allocate()
+    void release(std::size_t slot) noexcept
+    {
+        auto w = slot / 64;
+        auto prev = words[w].fetch_and(~(std::uint64_t(1) << (slot % 64)), std::memory_order_release);
+        if (prev == full)
+            summary[w / 64].fetch_and(~summary_bit(w), std::memory_order_acq_rel);
+    }
+
+    bool test(std::size_t slot) const noexcept
+    {
+        return (words[slot / 64].load(std::memory_order_acquire) >> (slot % 64)) & 1;
+    }
+
+    // Slots in use - only exact when no other thread is allocating or releasing
+    std::size_t count() const noexcept
+    {
+        std::size_t n = 0;
+        for (std::size_t w = 0; w < n_words; ++w)
+            n += std::popcount(words[w].load(std::memory_order_relaxed));
+        return n - (n_words * 64 - n_slots);
+    }
+
+    std::size_t capacity() const noexcept { return n_slots; }
+
+private:
+    static constexpr std::uint64_t full = ~std::uint64_t(0);
+
+    // A word with the first `used` bits free and the rest set
+    static constexpr std::uint64_t padding(std::size_t used) noexcept
+    {
+        return used >= 64 ? 0 : full << used;
+    }
+
+    static constexpr std::uint64_t summary_bit(std::size_t w) noexcept
+    {
+        return std::uint64_t(1) << (w % 64);
+    }
+
+    // Take the lowest free slot in word w
+    std::optional<std::size_t> claim(std::size_t w) noexcept
+    {
+        auto bits = words[w].load(std::memory_order_relaxed);
+        while (bits != full) {
+            auto i = std::countr_one(bits);
+            auto bit = std::uint64_t(1) << i;
+            auto prev = words[w].fetch_or(bit, std::memory_order_acquire);
+            if (!(prev & bit)) {
+                if ((prev | bit) == full)
+                    mark_full(w);
+                return w * 64 + i;
+            }
+            bits = prev | bit;
+        }
+        // The summary said there was room - fix it
+        mark_full(w);
+        return std::nullopt;
+    }
+
+    void mark_full(std::size_t w) noexcept
+    {
+        summary[w / 64].fetch_or(summary_bit(w), std::memory_order_acq_rel);
+        // A release() which cleared the summary bit before we set it has already cleared its slot bit,
+        // and the acq_rel pair makes that visible here
+        if (words[w].load(std::memory_order_relaxed) != full)
+            summary[w / 64].fetch_and(~summary_bit(w), std::memory_order_acq_rel);
+    }
+
+    std::size_t n_slots;
+    std::size_t n_words;
+    std::size_t n_summary;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> summary;
+
+    // Where each thread starts searching: an index into summary
+    per_thread_array<std::atomic<std::size_t>> hints;
+};
+
+#endif //ATOMIC_BITMAP_H
@@ -0,0 +1,51 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/*
+ * Backoff
+ *
+ * - When a CAS fails, another thread is changing the same word
+ *      - Retrying immediately just makes the cache line bounce more
+ * - Wait a little before retrying, and wait longer after each failure
+ *      - cpu_relax() (pause on x86) between attempts
+ *      - After many failures, yield the processor
+ *      */
+
+// Tell the processor we are in a spin loop
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+class backoff {
+public:
+    void pause() noexcept
+    {
+        if (spins <= max_spins) {
+            for (int i = 0; i < spins; ++i)
+                cpu_relax();
+            spins *= 2;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    void reset() noexcept { spins = 1; }
+
+private:
+    static constexpr int max_spins = 64;
+    int spins = 1;
+};
+
+#endif //BACKOFF_H
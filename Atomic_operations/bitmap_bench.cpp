@@ -0,0 +1,211 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "atomic_bitmap.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * atomic_bitmap benchmark
+ *
+ * - Check first
+ *      - Fill a bitmap to capacity from several threads - every slot exactly once, then nothing
+ *      - Threads allocate and release at random - no slot may be owned by two threads at once
+ *
+ * - Then allocate 16 slots and release them, in a table of 1M slots
+ *      - empty: every slot free
+ *      - mostly_full: the first 15/16 of the table in use, so searches must skip over it
+ *      - atomic_bitmap vs a free list in a std::vector under a std::mutex,
+ *        and a bitmap with no summary level which searches from slot 0
+ *      */
+
+constexpr std::size_t table_size = 1 << 20;
+constexpr int batch = 16;
+
+// One level only: search every word from the start of the table
+class flat_bitmap {
+public:
+    explicit flat_bitmap(std::size_t capacity) : n_words(capacity / 64), words(new std::atomic<std::uint64_t>[n_words]()) {}
+
+    std::optional<std::size_t> allocate() noexcept
+    {
+        for (std::size_t w = 0; w < n_words; ++w) {
+            auto bits = words[w].load(std::memory_order_relaxed);
+            while (bits != ~std::uint64_t(0)) {
+                auto i = std::countr_one(bits);
+                auto bit = std::uint64_t(1) << i;
+                auto prev = words[w].fetch_or(bit, std::memory_order_acquire);
+                if (!(prev & bit))
+                    return w * 64 + i;
+                bits = prev | bit;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void release(std::size_t slot) noexcept
+    {
+        words[slot / 64].fetch_and(~(std::uint64_t(1) << (slot % 64)), std::memory_order_release);
+    }
+
+private:
+    std::size_t n_words;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words;
+};
+
+class locked_free_list {
+public:
+    explicit locked_free_list(std::size_t capacity)
+    {
+        for (std::size_t i = capacity; i-- > 0;)
+            free.push_back(i);
+    }
+
+    std::optional<std::size_t> allocate()
+    {
+        std::lock_guard<std::mutex> lg(mut);
+        if (free.empty())
+            return std::nullopt;
+        auto slot = free.back();
+        free.pop_back();
+        return slot;
+    }
+
+    void release(std::size_t slot)
+    {
+        std::lock_guard<std::mutex> lg(mut);
+        free.push_back(slot);
+    }
+
+private:
+    alignas(cache_line_size) std::mutex mut;
+    std::vector<std::size_t> free;
+};
+
+bool check()
+{
+    constexpr std::size_t capacity = 100'003;       // Not a multiple of 64
+    constexpr int n_threads = 4;
+    atomic_bitmap slots(capacity);
+    std::vector<std::atomic<int>> owner(capacity);
+    for (auto &o : owner)
+        o.store(-1, std::memory_order_relaxed);
+    std::atomic<bool> ok{true};
+
+    // Fill to capacity
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            while (auto slot = slots.allocate()) {
+                if (*slot >= capacity || owner[*slot].exchange(t) != -1)
+                    ok = false;
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    threads.clear();
+    if (slots.count() != capacity || slots.allocate())
+        return false;
+    for (std::size_t i = 0; i < capacity; ++i) {
+        if (owner[i].load() == -1)
+            return false;
+        owner[i].store(-1);
+        slots.release(i);
+    }
+    if (slots.count() != 0)
+        return false;
+
+    // Allocate and release at random, keeping the bitmap nearly full
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<std::size_t> held;
+            std::uint32_t x = 2463534242u + t;
+            for (int i = 0; i < 200'000; ++i) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                if (held.size() < capacity / n_threads - 10 && (x % 4 != 0 || held.empty())) {
+                    if (auto slot = slots.allocate()) {
+                        if (owner[*slot].exchange(t) != -1)
+                            ok = false;
+                        held.push_back(*slot);
+                    }
+                }
+                else if (!held.empty()) {
+                    auto k = x % held.size();
+                    auto slot = held[k];
+                    held[k] = held.back();
+                    held.pop_back();
+                    if (owner[slot].exchange(-1) != t)
+                        ok = false;
+                    slots.release(slot);
+                }
+            }
+            for (auto slot : held) {
+                owner[slot].store(-1);
+                slots.release(slot);
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    return ok && slots.count() == 0;
+}
+
+// Hold the first 15/16 of the table
+template<typename Slots>
+std::vector<std::size_t> fill_most(Slots &slots)
+{
+    std::vector<std::size_t> held;
+    for (std::size_t i = 0; i < table_size / 16 * 15; ++i)
+        held.push_back(*slots.allocate());
+    return held;
+}
+
+template<typename Slots>
+void allocate_release(Slots &slots)
+{
+    std::size_t held[batch];
+    int n = 0;
+    for (; n < batch; ++n) {
+        auto slot = slots.allocate();
+        if (!slot)
+            break;
+        held[n] = *slot;
+    }
+    bench::clobber_memory();
+    while (n > 0)
+        slots.release(held[--n]);
+}
+
+atomic_bitmap bitmap_empty(table_size), bitmap_full(table_size);
+flat_bitmap flat_empty(table_size), flat_full(table_size);
+locked_free_list locked_empty(table_size), locked_full(table_size);
+
+int main(int argc, char *argv[])
+{
+    if (!check()) {
+        std::printf("check: FAILED\n");
+        return 1;
+    }
+    std::printf("check: ok\n");
+
+    fill_most(bitmap_full);
+    fill_most(flat_full);
+    fill_most(locked_full);
+
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("atomic_bitmap/empty", [](bench::context &) { allocate_release(bitmap_empty); }).threads(thread_counts);
+    bench::add("atomic_bitmap/mostly_full", [](bench::context &) { allocate_release(bitmap_full); }).threads(thread_counts);
+    bench::add("flat_bitmap/empty", [](bench::context &) { allocate_release(flat_empty); }).threads(thread_counts);
+    bench::add("flat_bitmap/mostly_full", [](bench::context &) { allocate_release(flat_full); }).threads(thread_counts);
+    bench::add("mutex_free_list/empty", [](bench::context &) { allocate_release(locked_empty); }).threads(thread_counts);
+    bench::add("mutex_free_list/mostly_full", [](bench::context &) { allocate_release(locked_full); }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
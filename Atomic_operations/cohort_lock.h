@@ -0,0 +1,218 @@
+#ifndef COHORT_LOCK_H
+#define COHORT_LOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "backoff.h"
+#include "padded.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+/*
+ * NUMA Topology
+ *
+ * - On a machine with several sockets, each socket ("node") has its own memory and caches
+ *      - Moving a cache line to a core on the same node is fast
+ *      - Moving it to the other socket is several times slower
+ *
+ * - Linux describes the nodes in /sys/devices/system/node
+ *      - node0/cpulist, node1/cpulist ... list each node's CPUs, e.g. "0-15,32-47"
+ *      - sched_getcpu() tells a thread which CPU it is running on
+ *
+ * - numa_topology::system() reads the real topology once
+ *      - No /sys (or not Linux): one node with every CPU
+ *
+ * - numa_topology::simulated(n) pretends there are n nodes
+ *      - Threads are given nodes in turn with thread_slot(), whatever CPU they run on
+ *      - For testing NUMA-aware code on a single-node machine
+ *      */
+
+class numa_topology {
+public:
+    static const numa_topology &system()
+    {
+        static const numa_topology topology = read_system();
+        return topology;
+    }
+
+    static numa_topology simulated(std::size_t n_nodes)
+    {
+        numa_topology t;
+        t.n_nodes = n_nodes > 0 ? n_nodes : 1;
+        t.simulate = true;
+        return t;
+    }
+
+    std::size_t nodes() const noexcept { return n_nodes; }
+
+    bool is_simulated() const noexcept { return simulate; }
+
+    // The node the calling thread is running on now - it may move at any time
+    std::size_t current_node() const noexcept
+    {
+        if (simulate)
+            return thread_slot() % n_nodes;
+#ifdef __linux__
+        int cpu = sched_getcpu();
+        if (cpu >= 0 && static_cast<std::size_t>(cpu) < cpu_node.size())
+            return cpu_node[cpu];
+#endif
+        return 0;
+    }
+
+private:
+    numa_topology() = default;
+
+    static numa_topology read_system()
+    {
+        numa_topology t;
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+            auto name = entry.path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || name.find_first_not_of("0123456789", 4) != std::string::npos)
+                continue;
+            auto node = std::stoul(name.substr(4));
+            std::ifstream cpulist(entry.path() / "cpulist");
+            std::string line;
+            if (!std::getline(cpulist, line))
+                continue;
+            for (auto [first, last] : parse_cpulist(line)) {
+                if (t.cpu_node.size() <= last)
+                    t.cpu_node.resize(last + 1, 0);
+                for (auto cpu = first; cpu <= last; ++cpu)
+                    t.cpu_node[cpu] = node;
+            }
+            t.n_nodes = std::max(t.n_nodes, node + 1);
+        }
+        return t;
+    }
+
+    // "0-3,8,10-11" -> {0, 3}, {8, 8}, {10, 11}
+    static std::vector<std::pair<std::size_t, std::size_t>> parse_cpulist(const std::string &line)
+    {
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        std::istringstream in(line);
+        std::string range;
+        while (std::getline(in, range, ',')) {
+            std::size_t first = 0, last = 0;
+            char dash = 0;
+            std::istringstream r(range);
+            if (!(r >> first))
+                continue;
+            last = (r >> dash >> last) && dash == '-' ? last : first;
+            if (last >= first)
+                ranges.emplace_back(first, last);
+        }
+        return ranges;
+    }
+
+    std::size_t n_nodes = 1;
+    bool simulate = false;
+    std::vector<std::size_t> cpu_node;         // Index is a CPU number
+};
+
+/*
+ * Cohort Lock
+ *
+ * - With mut or lock_cout, the next owner is whichever thread wins the race
+ *      - On a two-socket machine, about half of the handoffs go to the other socket
+ *      - The lock and the data it protects move across on each of those handoffs
+ *
+ * - A cohort lock has one global lock, plus one local lock for each NUMA node
+ *      - A thread first takes its node's local lock, then the global lock
+ *      - On unlock, if another thread on the same node is waiting for the local lock,
+ *        the global lock is passed to it - it does not need to take the global lock again
+ *      - The threads of one node (a "cohort") take turns while the other nodes wait
+ *
+ * - Fairness
+ *      - After max_handoffs handoffs in a row, the global lock is released anyway,
+ *        so other nodes get a turn
+ *
+ * - The local locks are ticket locks
+ *      - A ticket lock knows whether anyone is waiting: next ticket != now serving + 1
+ *      - The global lock is released by whichever thread of the cohort finishes last,
+ *        not by the thread which took it, so it is a simple flag (not a std::mutex)
+ *
+ * - Works with std::lock_guard
+ *          cohort_lock lock;                                        // Real topology
+ *          cohort_lock test_lock(numa_topology::simulated(2));      // Pretend there are 2 nodes
+ *          std::lock_guard<cohort_lock> lg(lock);
+ *      */
+
+class cohort_lock {
+public:
+    explicit cohort_lock(const numa_topology &topology = numa_topology::system(), unsigned max_handoffs = 64)
+        : topology(topology), max_handoffs(max_handoffs), locals(new padded<local_lock>[topology.nodes()]) {}
+
+    cohort_lock(const cohort_lock &) = delete;
+    cohort_lock &operator=(const cohort_lock &) = delete;
+
+    void lock() noexcept
+    {
+        auto node = topology.current_node();
+        auto &local = locals[node].value;
+
+        auto ticket = local.next.fetch_add(1, std::memory_order_relaxed);
+        backoff b;
+        while (local.serving.load(std::memory_order_acquire) != ticket)
+            b.pause();
+
+        // The previous owner on this node may have passed us the global lock
+        if (!local.has_global) {
+            b.reset();
+            while (global->test(std::memory_order_relaxed) || global->test_and_set(std::memory_order_acquire))
+                b.pause();
+        }
+        owner_node = node;
+    }
+
+    void unlock() noexcept
+    {
+        // This thread may have moved to another node since lock()
+        auto &local = locals[owner_node].value;
+        auto serving = local.serving.load(std::memory_order_relaxed);
+        bool waiters = local.next.load(std::memory_order_relaxed) != serving + 1;
+
+        if (waiters && local.handoffs < max_handoffs) {
+            ++local.handoffs;
+            local.has_global = true;
+        }
+        else {
+            local.handoffs = 0;
+            local.has_global = false;
+            global->clear(std::memory_order_release);
+        }
+        local.serving.store(serving + 1, std::memory_order_release);
+    }
+
+    std::size_t nodes() const noexcept { return topology.nodes(); }
+
+private:
+    struct local_lock {
+        std::atomic<unsigned> next{0};
+        std::atomic<unsigned> serving{0};
+
+        // Only used by the owner of this local lock
+        bool has_global = false;
+        unsigned handoffs = 0;
+    };
+
+    numa_topology topology;
+    unsigned max_handoffs;
+    std::unique_ptr<padded<local_lock>[]> locals;
+    padded<std::atomic_flag> global;
+    std::size_t owner_node = 0;                 // Only used by the owner of the lock
+};
+
+#endif //COHORT_LOCK_H
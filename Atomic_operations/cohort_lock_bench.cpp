@@ -0,0 +1,145 @@
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "backoff.h"
+#include "cohort_lock.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Cohort lock benchmark
+ *
+ * - Check first, with the real topology and with 1, 2 and 4 simulated nodes
+ *      - Threads increment a plain counter under the lock - the total must be exact
+ *      - Also counts how often the lock moves to a thread on another (simulated) node,
+ *        compared with the atomic_flag spin lock from task() (with backoff)
+ *
+ * - Then a short critical section which writes 4 cache lines of shared data
+ *      - cohort_lock with the real topology and with 2 simulated nodes
+ *      - The atomic_flag spin lock (with backoff) and a std::mutex
+ *      - On a single-node machine the real topology has one cohort: it behaves like a ticket lock
+ *        whose owner sometimes skips the global flag
+ *      */
+
+struct shared_data {
+    alignas(cache_line_size) long long values[4 * cache_line_size / sizeof(long long)] = {};
+
+    void update() noexcept
+    {
+        for (std::size_t i = 0; i < std::size(values); i += cache_line_size / sizeof(long long))
+            ++values[i];
+    }
+};
+
+class flag_lock {
+public:
+    void lock() noexcept
+    {
+        backoff b;
+        while (flag.test_and_set(std::memory_order_acquire))
+            b.pause();
+    }
+
+    void unlock() noexcept { flag.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+// Returns the fraction of acquisitions which moved to another node, or -1 if the count was wrong
+template<typename Lock>
+double count_node_changes(Lock &lock, const numa_topology &topology)
+{
+    constexpr int n_threads = 8;
+    constexpr int n = 20'000;
+    long long counter = 0;
+    long long changes = 0;
+    std::size_t last_node = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < n; ++i) {
+                std::lock_guard<Lock> lg(lock);
+                auto node = topology.current_node();
+                if (node != last_node)
+                    ++changes;
+                last_node = node;
+                ++counter;
+                // Let the other threads queue up, even on a single core
+                if (i % 8 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    return counter == n_threads * n ? double(changes) / counter : -1;
+}
+
+bool check()
+{
+    bool ok = true;
+    auto report = [&](const char *name, double changes) {
+        if (changes < 0)
+            ok = false;
+        std::printf("%-24s %.1f%% of acquisitions changed node\n", name, changes * 100);
+    };
+
+    cohort_lock system_lock;
+    std::printf("system topology: %zu node(s)\n", system_lock.nodes());
+    report("cohort/system", count_node_changes(system_lock, numa_topology::system()));
+
+    for (std::size_t n_nodes : {1, 2, 4}) {
+        auto topology = numa_topology::simulated(n_nodes);
+        cohort_lock lock(topology);
+        flag_lock spin;
+        char name[32];
+        std::snprintf(name, sizeof(name), "cohort/simulated_%zu", n_nodes);
+        report(name, count_node_changes(lock, topology));
+        std::snprintf(name, sizeof(name), "spin_lock/simulated_%zu", n_nodes);
+        report(name, count_node_changes(spin, topology));
+    }
+    return ok;
+}
+
+shared_data data_cohort, data_simulated, data_spin, data_mutex;
+cohort_lock lock_cohort;
+cohort_lock lock_simulated(numa_topology::simulated(2));
+padded<flag_lock> lock_cout;
+padded<std::mutex> mut;
+
+int main(int argc, char *argv[])
+{
+    if (!check()) {
+        std::printf("check: FAILED\n");
+        return 1;
+    }
+    std::printf("check: ok\n");
+
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("cohort_lock/system", [](bench::context &) {
+        std::lock_guard<cohort_lock> lg(lock_cohort);
+        data_cohort.update();
+    }).threads(thread_counts);
+
+    bench::add("cohort_lock/simulated_2", [](bench::context &) {
+        std::lock_guard<cohort_lock> lg(lock_simulated);
+        data_simulated.update();
+    }).threads(thread_counts);
+
+    bench::add("atomic_flag_spin_lock", [](bench::context &) {
+        std::lock_guard<flag_lock> lg(*lock_cout);
+        data_spin.update();
+    }).threads(thread_counts);
+
+    bench::add("mutex", [](bench::context &) {
+        std::lock_guard<std::mutex> lg(*mut);
+        data_mutex.update();
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
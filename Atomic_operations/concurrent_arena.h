@@ -0,0 +1,178 @@
+#ifndef CONCURRENT_ARENA_H
+#define CONCURRENT_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include "padded.h"
+
+/*
+ * Concurrent Arena (bump allocator)
+ *
+ * - Atomic pointers (and integers) have fetch_add()
+ *      - Many threads can each reserve a different part of one buffer, with one atomic instruction
+ *
+ * - An arena hands out memory by "bumping" a cursor through a large buffer
+ *      - There is no free: all the memory is released at once by reset()
+ *      - e.g. everything allocated while handling a batch of requests
+ *
+ * - One fetch_add() per allocation would still make every thread write to the cursor
+ *      - So each thread reserves a chunk (16K by default) with fetch_add(),
+ *        and bumps its own pointer through the chunk with no atomics at all
+ *      - Big allocations get their own fetch_add()
+ *
+ * - reset() makes every thread's chunk stale - the next allocation reserves a new one
+ *      - No other thread may be allocating during reset(), and nothing from the arena may still be in use
+ *
+ * - arena_resource adapts an arena to std::pmr::memory_resource
+ *          concurrent_arena arena(64 << 20);
+ *          arena_resource resource(arena);
+ *          std::pmr::vector<int> v(&resource);
+ *      */
+
+class concurrent_arena {
+public:
+    explicit concurrent_arena(std::size_t capacity, std::size_t chunk_size = 16 * 1024)
+        : buffer(static_cast<std::byte *>(::operator new(capacity, std::align_val_t(cache_line_size)))),
+          size(capacity), chunk_size(chunk_size), token(next_token()) {}
+
+    ~concurrent_arena() { ::operator delete(buffer, std::align_val_t(cache_line_size)); }
+
+    concurrent_arena(const concurrent_arena &) = delete;
+    concurrent_arena &operator=(const concurrent_arena &) = delete;
+
+    // Thread-safe. Throws std::bad_alloc when the arena is full
+    void *allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t))
+    {
+        auto t = token.load(std::memory_order_relaxed);
+        chunk *c = find_chunk(t);
+        if (c) {
+            if (void *p = c->bump(bytes, align))
+                return p;
+        }
+
+        // Too big to share a chunk - reserve exactly what is needed
+        if (bytes + align > chunk_size / 4)
+            return align_up(reserve(bytes + align - 1), align);
+
+        if (!c)
+            c = replace_chunk();
+        auto *start = reserve(chunk_size);
+        *c = chunk{t, start, start + chunk_size};
+        return c->bump(bytes, align);
+    }
+
+    // Not thread-safe: see above
+    void reset() noexcept
+    {
+        cursor->store(0, std::memory_order_relaxed);
+        token.store(next_token(), std::memory_order_relaxed);
+    }
+
+    // Bytes reserved by threads so far (more than has been allocated)
+    std::size_t used() const noexcept
+    {
+        auto n = cursor->load(std::memory_order_relaxed);
+        return n < size ? n : size;
+    }
+
+    std::size_t capacity() const noexcept { return size; }
+
+private:
+    // A thread's current chunk in one arena, valid while token matches the arena's
+    struct chunk {
+        std::uint64_t token = 0;
+        std::byte *next = nullptr;
+        std::byte *end = nullptr;
+
+        void *bump(std::size_t bytes, std::size_t align) noexcept
+        {
+            auto *p = align_up(next, align);
+            if (p > end || std::size_t(end - p) < bytes)
+                return nullptr;
+            next = p + bytes;
+            return p;
+        }
+    };
+
+    // A thread may use a few arenas at once without losing its chunks
+    static constexpr int chunks_per_thread = 4;
+
+    struct thread_chunks {
+        chunk chunks[chunks_per_thread];
+        unsigned victim = 0;
+    };
+
+    static thread_chunks &local()
+    {
+        thread_local thread_chunks tc;
+        return tc;
+    }
+
+    static chunk *find_chunk(std::uint64_t t) noexcept
+    {
+        for (auto &c : local().chunks) {
+            if (c.token == t)
+                return &c;
+        }
+        return nullptr;
+    }
+
+    static chunk *replace_chunk() noexcept
+    {
+        auto &tc = local();
+        return &tc.chunks[tc.victim++ % chunks_per_thread];
+    }
+
+    // Every arena and every reset() gets a new token, so an old chunk is never mistaken for a current one
+    static std::uint64_t next_token() noexcept
+    {
+        static std::atomic<std::uint64_t> tokens{0};
+        return tokens.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    static std::byte *align_up(std::byte *p, std::size_t align) noexcept
+    {
+        auto a = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((align - a % align) % align);
+    }
+
+    std::byte *reserve(std::size_t bytes)
+    {
+        auto offset = cursor->fetch_add(bytes, std::memory_order_relaxed);
+        if (offset > size || size - offset < bytes)
+            throw std::bad_alloc();
+        return buffer + offset;
+    }
+
+    // Read-only after construction, apart from token which only changes in reset()
+    std::byte *buffer;
+    std::size_t size;
+    std::size_t chunk_size;
+    std::atomic<std::uint64_t> token;
+
+    padded<std::atomic<std::size_t>> cursor{0};
+};
+
+// Lets std::pmr containers allocate from a concurrent_arena - deallocation does nothing
+class arena_resource : public std::pmr::memory_resource {
+public:
+    explicit arena_resource(concurrent_arena &arena) noexcept : arena(arena) {}
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t align) override { return arena.allocate(bytes, align); }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        auto *r = dynamic_cast<const arena_resource *>(&other);
+        return r && &r->arena == &arena;
+    }
+
+    concurrent_arena &arena;
+};
+
+#endif //CONCURRENT_ARENA_H
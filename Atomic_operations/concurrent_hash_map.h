@@ -0,0 +1,415 @@
+#ifndef CONCURRENT_HASH_MAP_H
+#define CONCURRENT_HASH_MAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#include "backoff.h"
+#include "padded.h"
+
+/*
+ * Concurrent Hash Map
+ *
+ * - A std::unordered_map under one lock (like mut or lock_cout) serialises every access
+ *      - A std::shared_mutex lets readers in together, but each reader still writes to the lock
+ *
+ * - Lock striping
+ *      - The map is split into segments by the top bits of the hash
+ *      - Each segment is a small open addressing table (linear probing) with its own lock
+ *      - Writers to different segments do not contend
+ *
+ * - Lock-free reads
+ *      - Each segment lock is also a version number, like seq_lock
+ *      - A writer makes the version odd while it changes the segment
+ *      - A reader probes without locking, then checks the version has not changed - if it has, try again
+ *      - The slots are stored as relaxed atomic words, so K and V must be trivially copyable
+ *
+ * - Incremental resizing
+ *      - When a segment gets too full, a table of twice the size is installed next to the old one
+ *      - Each later write to the segment moves a few old slots across
+ *      - Lookups check both tables until the old one is empty
+ *      - No operation ever has to rehash a whole segment
+ *      - Old tables are kept until the map is destroyed, because a reader may still be probing one
+ *        (at most the size of the current tables, since tables only grow)
+ *
+ * - Erasing moves later entries back into the gap ("backward shift deletion"), so there are no tombstones
+ *
+ *          concurrent_hash_map<long, double> results;
+ *          results.insert_or_assign(request_id, value);
+ *          if (auto v = results.find(request_id)) ...
+ *      */
+
+template<typename K, typename V, typename Hash = std::hash<K>>
+class concurrent_hash_map {
+    static_assert(std::is_trivially_copyable_v<K> && std::has_unique_object_representations_v<K>,
+                  "concurrent_hash_map keys are compared bitwise");
+    static_assert(std::is_trivially_copyable_v<V>, "concurrent_hash_map requires a trivially copyable V");
+
+public:
+    explicit concurrent_hash_map(std::size_t n_segments = 64, const Hash &hash = Hash())
+        : segment_bits(log2_ceil(n_segments < 1 ? 1 : n_segments)),
+          segments(new padded<segment>[std::size_t(1) << segment_bits]),
+          hasher(hash) {}
+
+    concurrent_hash_map(const concurrent_hash_map &) = delete;
+    concurrent_hash_map &operator=(const concurrent_hash_map &) = delete;
+
+    // Lock-free: never waits for a lock, but retries if a writer changes the segment meanwhile
+    std::optional<V> find(const K &key) const
+    {
+        auto h = hash_of(key);
+        const segment &s = segment_for(h);
+
+        backoff b;
+        while (true) {
+            auto v1 = s.version.load(std::memory_order_acquire);
+            if (!(v1 & 1)) {
+                std::optional<V> result;
+                const table *t = s.current.load(std::memory_order_acquire);
+                const table *o = s.old.load(std::memory_order_acquire);
+                if (const slot *p = t->find(h, key))
+                    result = p->value.load();
+                else if (o) {
+                    if (const slot *q = o->find(h, key))
+                        result = q->value.load();
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (s.version.load(std::memory_order_relaxed) == v1)
+                    return result;
+            }
+            b.pause();
+        }
+    }
+
+    bool contains(const K &key) const { return find(key).has_value(); }
+
+    // Returns true if the key was inserted, false if an existing value was replaced
+    bool insert_or_assign(const K &key, const V &value)
+    {
+        auto h = hash_of(key);
+        segment &s = segment_for(h);
+        write_lock wl(s);
+        s.migrate_some();
+
+        table *t = s.current.load(std::memory_order_relaxed);
+        if (slot *p = t->find(h, key)) {
+            p->value.store(value);
+            return false;
+        }
+
+        // Still in the old table - move it to the new one
+        if (table *o = s.old.load(std::memory_order_relaxed)) {
+            if (slot *q = o->find(h, key)) {
+                q->state.store(moved, std::memory_order_relaxed);
+                --o->count;
+                t->insert(h, key, value);
+                return false;
+            }
+        }
+
+        if (s.needs_grow())
+            t = s.grow();
+        t->insert(h, key, value);
+        s.size.store(s.size.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool erase(const K &key)
+    {
+        auto h = hash_of(key);
+        segment &s = segment_for(h);
+        write_lock wl(s);
+        s.migrate_some();
+
+        bool erased = s.current.load(std::memory_order_relaxed)->erase(h, key);
+        if (!erased) {
+            if (table *o = s.old.load(std::memory_order_relaxed)) {
+                if (slot *q = o->find(h, key)) {
+                    q->state.store(moved, std::memory_order_relaxed);
+                    --o->count;
+                    erased = true;
+                }
+            }
+        }
+        if (erased)
+            s.size.store(s.size.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        return erased;
+    }
+
+    // Only exact when no other thread is writing
+    std::size_t size() const noexcept
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < n_segments(); ++i)
+            n += segments[i]->size.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    std::size_t n_segments() const noexcept { return std::size_t(1) << segment_bits; }
+
+private:
+    // A trivially copyable value stored as relaxed atomic words
+    template<typename T>
+    struct atomic_words {
+        using word = std::uint64_t;
+        static constexpr std::size_t n_words = (sizeof(T) + sizeof(word) - 1) / sizeof(word);
+
+        std::atomic<word> data[n_words] = {};
+
+        void store(const T &value) noexcept
+        {
+            word buffer[n_words] = {};
+            std::memcpy(buffer, &value, sizeof(T));
+            for (std::size_t i = 0; i < n_words; ++i)
+                data[i].store(buffer[i], std::memory_order_relaxed);
+        }
+
+        T load() const noexcept
+        {
+            word buffer[n_words];
+            for (std::size_t i = 0; i < n_words; ++i)
+                buffer[i] = data[i].load(std::memory_order_relaxed);
+            T value;
+            std::memcpy(&value, buffer, sizeof(T));
+            return value;
+        }
+
+        bool equals(const T &value) const noexcept
+        {
+            word buffer[n_words] = {};
+            std::memcpy(buffer, &value, sizeof(T));
+            for (std::size_t i = 0; i < n_words; ++i) {
+                if (data[i].load(std::memory_order_relaxed) != buffer[i])
+                    return false;
+            }
+            return true;
+        }
+
+        void copy_from(const atomic_words &other) noexcept
+        {
+            for (std::size_t i = 0; i < n_words; ++i)
+                data[i].store(other.data[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    };
+
+    // Slot states. A moved slot is only found in an old table which is being emptied
+    static constexpr std::uint8_t empty = 0;
+    static constexpr std::uint8_t full = 1;
+    static constexpr std::uint8_t moved = 2;
+
+    struct slot {
+        std::atomic<std::uint8_t> state{empty};
+        std::atomic<std::uint64_t> hash{0};
+        atomic_words<K> key;
+        atomic_words<V> value;
+
+        void copy_from(const slot &other) noexcept
+        {
+            hash.store(other.hash.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            key.copy_from(other.key);
+            value.copy_from(other.value);
+            state.store(full, std::memory_order_relaxed);
+        }
+    };
+
+    // Readers may probe a table while a writer changes it - they notice from the version
+    // So every probe is bounded by the capacity, even if the table looks inconsistent
+    struct table {
+        explicit table(std::size_t capacity) : mask(capacity - 1), slots(new slot[capacity]) {}
+
+        std::size_t capacity() const noexcept { return mask + 1; }
+
+        slot *find(std::uint64_t h, const K &key) const noexcept
+        {
+            auto i = h & mask;
+            for (std::size_t n = 0; n <= mask; ++n, i = (i + 1) & mask) {
+                auto st = slots[i].state.load(std::memory_order_relaxed);
+                if (st == empty)
+                    return nullptr;
+                if (st == full && slots[i].hash.load(std::memory_order_relaxed) == h && slots[i].key.equals(key))
+                    return &slots[i];
+            }
+            return nullptr;
+        }
+
+        // Caller holds the lock and has checked the key is not present
+        void insert(std::uint64_t h, const K &key, const V &value) noexcept
+        {
+            slot &s = slots[empty_slot(h)];
+            s.hash.store(h, std::memory_order_relaxed);
+            s.key.store(key);
+            s.value.store(value);
+            s.state.store(full, std::memory_order_relaxed);
+            ++count;
+        }
+
+        void insert_copy(const slot &from) noexcept
+        {
+            slots[empty_slot(from.hash.load(std::memory_order_relaxed))].copy_from(from);
+            ++count;
+        }
+
+        std::size_t empty_slot(std::uint64_t h) const noexcept
+        {
+            auto i = h & mask;
+            while (slots[i].state.load(std::memory_order_relaxed) != empty)
+                i = (i + 1) & mask;
+            return i;
+        }
+
+        // Backward shift deletion: pull later entries of the probe sequence into the gap
+        bool erase(std::uint64_t h, const K &key) noexcept
+        {
+            slot *p = find(h, key);
+            if (!p)
+                return false;
+
+            auto gap = std::size_t(p - slots.get());
+            auto i = gap;
+            while (true) {
+                i = (i + 1) & mask;
+                if (slots[i].state.load(std::memory_order_relaxed) == empty)
+                    break;
+                auto home = slots[i].hash.load(std::memory_order_relaxed) & mask;
+                // Move slot i back if its home is not in (gap, i]
+                if (((i - home) & mask) >= ((i - gap) & mask)) {
+                    slots[gap].copy_from(slots[i]);
+                    gap = i;
+                }
+            }
+            slots[gap].state.store(empty, std::memory_order_relaxed);
+            --count;
+            return true;
+        }
+
+        std::size_t mask;
+        std::unique_ptr<slot[]> slots;
+        std::size_t count = 0;          // Full slots - only used under the lock
+    };
+
+    struct segment {
+        static constexpr std::size_t initial_capacity = 16;
+        static constexpr std::size_t migrate_batch = 16;
+
+        // (number of writes << 1) | locked
+        std::atomic<std::uint64_t> version{0};
+        std::atomic<table *> current{nullptr};
+        std::atomic<table *> old{nullptr};
+        std::size_t migrated = 0;                       // Old slots already moved
+        std::atomic<std::size_t> size{0};
+        std::vector<std::unique_ptr<table>> tables;     // Every table this segment has used
+
+        segment()
+        {
+            tables.push_back(std::make_unique<table>(initial_capacity));
+            current.store(tables.back().get(), std::memory_order_relaxed);
+        }
+
+        void lock() noexcept
+        {
+            backoff b;
+            while (true) {
+                auto v = version.load(std::memory_order_relaxed);
+                if (!(v & 1) && version.compare_exchange_weak(v, v | 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    // Readers must see the odd version before any change to the slots
+                    std::atomic_thread_fence(std::memory_order_release);
+                    return;
+                }
+                b.pause();
+            }
+        }
+
+        void unlock() noexcept
+        {
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        bool needs_grow() const noexcept
+        {
+            const table *t = current.load(std::memory_order_relaxed);
+            const table *o = old.load(std::memory_order_relaxed);
+            auto entries = t->count + (o ? o->count : 0) + 1;
+            return entries * 4 > t->capacity() * 3;
+        }
+
+        // Move up to n slots from the old table
+        void migrate(std::size_t n) noexcept
+        {
+            table *o = old.load(std::memory_order_relaxed);
+            if (!o)
+                return;
+            table *t = current.load(std::memory_order_relaxed);
+            for (; n > 0 && migrated < o->capacity(); --n, ++migrated) {
+                slot &from = o->slots[migrated];
+                if (from.state.load(std::memory_order_relaxed) == full) {
+                    t->insert_copy(from);
+                    from.state.store(moved, std::memory_order_relaxed);
+                    --o->count;
+                }
+            }
+            if (migrated == o->capacity())
+                old.store(nullptr, std::memory_order_release);
+        }
+
+        void migrate_some() noexcept { migrate(migrate_batch); }
+
+        table *grow()
+        {
+            if (old.load(std::memory_order_relaxed))
+                migrate(std::size_t(-1));
+            table *t = current.load(std::memory_order_relaxed);
+            tables.push_back(std::make_unique<table>(t->capacity() * 2));
+            old.store(t, std::memory_order_release);
+            current.store(tables.back().get(), std::memory_order_release);
+            migrated = 0;
+            return tables.back().get();
+        }
+    };
+
+    class write_lock {
+    public:
+        explicit write_lock(segment &s) : s(s) { s.lock(); }
+        ~write_lock() { s.unlock(); }
+
+    private:
+        segment &s;
+    };
+
+    static std::size_t log2_ceil(std::size_t n) noexcept
+    {
+        std::size_t bits = 0;
+        while ((std::size_t(1) << bits) < n)
+            ++bits;
+        return bits;
+    }
+
+    // Mix the hash, so identity hashes (std::hash<int>) still spread over the segments and slots
+    std::uint64_t hash_of(const K &key) const noexcept
+    {
+        std::uint64_t h = hasher(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    segment &segment_for(std::uint64_t h) const noexcept
+    {
+        return *segments[segment_bits ? (h >> (64 - segment_bits)) : 0];
+    }
+
+    std::size_t segment_bits;
+    std::unique_ptr<padded<segment>[]> segments;
+    Hash hasher;
+};
+
+#endif //CONCURRENT_HASH_MAP_H
@@ -0,0 +1,214 @@
+#ifndef EPOCH_RECLAMATION_H
+#define EPOCH_RECLAMATION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "padded.h"
+
+/*
+ * Epoch-Based Reclamation (EBR)
+ *
+ * - Hazard pointers protect one node at a time
+ *      - A store and a full fence for every node we read
+ * - EBR protects everything at once, for the duration of a "read section"
+ *
+ * - There is a global epoch number
+ *      - Entering a read section, a thread records the current epoch and marks itself active
+ *      - A retired node goes on the thread's limbo list, tagged with the epoch
+ *
+ * - The global epoch can only advance when every active thread has seen it
+ *      - So once the epoch has advanced twice past a node's tag, no thread can
+ *        still be in a read section which started before the node was removed
+ *      - The node can be freed. Frees are done in batches
+ *
+ * - Much cheaper per access than hazard pointers
+ *      - But a thread which stays in a read section stops all reclamation
+ *      - Memory use is not bounded
+ *
+ * - Same interface as hazard_pointers, so containers can use either
+ *          treiber_stack<int, epoch_reclamation> stack;
+ *
+ *          epoch_reclamation::guard g;         // Read section for this scope
+ *          node *p = g.protect(head);          // Just a load
+ *          epoch_reclamation::retire(p);
+ *      */
+
+class epoch_reclamation {
+public:
+    static constexpr std::size_t max_threads = 256;
+
+    // Read section - nodes read inside it stay valid until it ends
+    // Guards can be nested
+    class guard {
+    public:
+        guard() { local().enter(); }
+        ~guard() { local().exit(); }
+
+        guard(const guard &) = delete;
+        guard &operator=(const guard &) = delete;
+
+        template<typename T>
+        T *protect(const std::atomic<T *> &src) noexcept { return src.load(std::memory_order_acquire); }
+
+        void reset() noexcept {}
+    };
+
+    template<typename T>
+    static void retire(T *p)
+    {
+        local().retire(p, [](void *q) { delete static_cast<T *>(q); });
+    }
+
+    // Try to advance the epoch and free this thread's old nodes now
+    static void collect() { local().collect(); }
+
+    static std::uint64_t epoch() noexcept { return global_epoch().load(std::memory_order_acquire); }
+
+private:
+    struct retired_node {
+        void *pointer;
+        void (*deleter)(void *);
+        std::uint64_t epoch;
+    };
+
+    struct record {
+        std::atomic<bool> in_use{false};
+        // (epoch << 1) | 1 while in a read section, 0 otherwise
+        std::atomic<std::uint64_t> state{0};
+    };
+
+    struct domain {
+        padded<std::atomic<std::uint64_t>> epoch{0};
+        padded<record> records[max_threads];
+        std::mutex orphans_mut;
+        std::vector<retired_node> orphans;      // Left behind by threads which have exited
+
+        // Only runs at program exit, when no thread can be in a read section
+        ~domain()
+        {
+            for (auto &n : orphans)
+                n.deleter(n.pointer);
+        }
+    };
+
+    static domain &global()
+    {
+        static domain d;
+        return d;
+    }
+
+    static std::atomic<std::uint64_t> &global_epoch() { return global().epoch.value; }
+
+    class thread_state {
+    public:
+        thread_state()
+        {
+            for (auto &r : global().records) {
+                bool expected = false;
+                if (!r->in_use.load(std::memory_order_relaxed)
+                    && r->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    rec = &r.value;
+                    return;
+                }
+            }
+            throw std::runtime_error("epoch_reclamation: too many threads");
+        }
+
+        ~thread_state()
+        {
+            collect();
+            if (!limbo.empty()) {
+                auto &d = global();
+                std::lock_guard<std::mutex> lg(d.orphans_mut);
+                d.orphans.insert(d.orphans.end(), limbo.begin(), limbo.end());
+            }
+            rec->state.store(0, std::memory_order_release);
+            rec->in_use.store(false, std::memory_order_release);
+        }
+
+        void enter() noexcept
+        {
+            if (nesting++ == 0) {
+                auto e = global_epoch().load(std::memory_order_relaxed);
+                rec->state.store((e << 1) | 1, std::memory_order_relaxed);
+                // Our state must be visible before we read any node
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        void exit() noexcept
+        {
+            if (--nesting == 0)
+                rec->state.store(0, std::memory_order_release);
+        }
+
+        void retire(void *p, void (*deleter)(void *))
+        {
+            limbo.push_back({p, deleter, global_epoch().load(std::memory_order_relaxed)});
+            if (limbo.size() >= next_collect) {
+                collect();
+                // If a slow reader is holding back the epoch, wait for another batch before trying again
+                next_collect = limbo.size() + batch_size;
+            }
+        }
+
+        void collect()
+        {
+            try_advance();
+
+            auto &d = global();
+            {
+                std::unique_lock<std::mutex> ul(d.orphans_mut, std::try_to_lock);
+                if (ul.owns_lock() && !d.orphans.empty()) {
+                    limbo.insert(limbo.end(), d.orphans.begin(), d.orphans.end());
+                    d.orphans.clear();
+                }
+            }
+
+            // Free every node retired two or more epochs ago
+            auto e = global_epoch().load(std::memory_order_acquire);
+            std::vector<retired_node> keep;
+            for (auto &n : limbo) {
+                if (n.epoch + 2 <= e)
+                    n.deleter(n.pointer);
+                else
+                    keep.push_back(n);
+            }
+            limbo.swap(keep);
+        }
+
+    private:
+        static constexpr std::size_t batch_size = 128;
+
+        // Advance the epoch if every thread in a read section has seen the current one
+        static void try_advance() noexcept
+        {
+            auto &d = global();
+            auto e = global_epoch().load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (auto &r : d.records) {
+                auto s = r->state.load(std::memory_order_acquire);
+                if ((s & 1) && (s >> 1) != e)
+                    return;
+            }
+            global_epoch().compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+        }
+
+        record *rec = nullptr;
+        int nesting = 0;
+        std::vector<retired_node> limbo;
+        std::size_t next_collect = batch_size;
+    };
+
+    static thread_state &local()
+    {
+        thread_local thread_state state;
+        return state;
+    }
+};
+
+#endif //EPOCH_RECLAMATION_H
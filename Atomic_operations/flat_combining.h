@@ -0,0 +1,212 @@
+#ifndef FLAT_COMBINING_H
+#define FLAT_COMBINING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "backoff.h"
+#include "padded.h"
+
+/*
+ * Flat Combining
+ *
+ * - With a lock around a data structure, each operation moves the lock's cache line
+ *   and the data's cache lines to another core
+ *      - With many threads, most of the time goes in these transfers, not in the operation
+ *
+ * - Instead, a thread publishes its operation in its own slot, then tries to take the lock
+ *      - The thread which gets the lock becomes the "combiner"
+ *      - It runs every published operation, and marks each one done
+ *      - The other threads wait on their own slot, which is in their own cache
+ *      - The data stays in the combiner's cache for the whole batch
+ *
+ * - N operations cost one lock acquisition and one batch of transfers, not N
+ *      - Works for any sequential data structure, e.g. std::vector as a stack
+ *      - Operations run on the combiner's thread - they must not use thread_local data
+ *      - An exception from an operation is passed back to the thread which published it
+ *
+ * - A thread which gets the lock straight away just runs its operation (and any published ones)
+ *
+ * - Slots are shared out with thread_slot(), so two threads may have the same slot
+ *      - A thread which finds its slot in use takes the lock and runs its operation itself
+ *
+ *          flat_combiner<std::vector<int>> stack;
+ *          stack.apply([](std::vector<int> &v) { v.push_back(42); });
+ *          auto size = stack.apply([](std::vector<int> &v) { return v.size(); });
+ *      */
+
+template<typename DS>
+class flat_combiner {
+public:
+    template<typename... Args>
+    explicit flat_combiner(Args &&...args) : ds(std::forward<Args>(args)...) {}
+
+    flat_combiner(const flat_combiner &) = delete;
+    flat_combiner &operator=(const flat_combiner &) = delete;
+
+    // Run f(ds) while no other operation is running, and return its result
+    template<typename F>
+    std::invoke_result_t<F &, DS &> apply(F &&f)
+    {
+        using result_type = std::invoke_result_t<F &, DS &>;
+        if constexpr (std::is_void_v<result_type>) {
+            execute(f);
+        }
+        else {
+            std::optional<result_type> result;
+            auto op = [&](DS &d) { result.emplace(f(d)); };
+            execute(op);
+            return std::move(*result);
+        }
+    }
+
+private:
+    enum : int { idle, claimed, pending, done };
+
+    struct record {
+        std::atomic<int> state{idle};
+        void (*run)(void *, DS &) = nullptr;
+        void *op = nullptr;
+        std::exception_ptr error;
+    };
+
+    // Each combiner makes this many passes over the slots, while it keeps finding work
+    static constexpr int combining_passes = 3;
+
+    template<typename Op>
+    void execute(Op &op)
+    {
+        auto run = [](void *p, DS &d) { (*static_cast<Op *>(p))(d); };
+
+        // Uncontended: no need to publish anything
+        if (try_lock()) {
+            run_locked(run, &op);
+            return;
+        }
+
+        auto &r = records.local();
+        int expected = idle;
+        if (!r.state.compare_exchange_strong(expected, claimed, std::memory_order_acquire, std::memory_order_relaxed)) {
+            // Another thread has this slot - take the lock and do it ourselves
+            backoff b;
+            while (!try_lock())
+                b.pause();
+            run_locked(run, &op);
+            return;
+        }
+
+        r.run = run;
+        r.op = &op;
+        r.state.store(pending, std::memory_order_release);
+
+        backoff b;
+        while (r.state.load(std::memory_order_acquire) != done) {
+            if (try_lock()) {
+                // Our operation is pending, so this runs it
+                combine();
+                unlock();
+                break;
+            }
+            b.pause();
+        }
+
+        auto error = std::exchange(r.error, nullptr);
+        r.state.store(idle, std::memory_order_release);
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // Called with the lock held: run our own operation, then any published ones, then unlock
+    void run_locked(void (*run)(void *, DS &), void *op)
+    {
+        try {
+            run(op, ds);
+        }
+        catch (...) {
+            unlock();
+            throw;
+        }
+        combine();
+        unlock();
+    }
+
+    // Called with the lock held
+    void combine() noexcept
+    {
+        for (int pass = 0; pass < combining_passes; ++pass) {
+            bool found = false;
+            records.for_each([&](record &r) {
+                if (r.state.load(std::memory_order_acquire) != pending)
+                    return;
+                try {
+                    r.run(r.op, ds);
+                }
+                catch (...) {
+                    r.error = std::current_exception();
+                }
+                r.state.store(done, std::memory_order_release);
+                found = true;
+            });
+            if (!found)
+                break;
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        return !lock->test(std::memory_order_relaxed) && !lock->test_and_set(std::memory_order_acquire);
+    }
+
+    void unlock() noexcept { lock->clear(std::memory_order_release); }
+
+    static std::size_t default_slots()
+    {
+        return std::max<std::size_t>(16, 2 * std::thread::hardware_concurrency());
+    }
+
+    padded<std::atomic_flag> lock;
+    per_thread_array<record> records{default_slots()};
+    alignas(cache_line_size) DS ds;
+};
+
+// A counter: every increment from a batch is done by one thread, on one cache line
+class combining_counter {
+public:
+    long long add(long long n) { return fc.apply([n](long long &c) { return c += n; }); }
+    long long get() { return fc.apply([](long long &c) { return c; }); }
+
+private:
+    flat_combiner<long long> fc{0};
+};
+
+// A sequential stack (std::vector) shared through flat combining
+template<typename T>
+class combining_stack {
+public:
+    void push(T value)
+    {
+        fc.apply([&value](std::vector<T> &v) { v.push_back(std::move(value)); });
+    }
+
+    std::optional<T> pop()
+    {
+        return fc.apply([](std::vector<T> &v) -> std::optional<T> {
+            if (v.empty())
+                return std::nullopt;
+            std::optional<T> top(std::move(v.back()));
+            v.pop_back();
+            return top;
+        });
+    }
+
+private:
+    flat_combiner<std::vector<T>> fc;
+};
+
+#endif //FLAT_COMBINING_H
@@ -0,0 +1,197 @@
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "flat_combining.h"
+#include "treiber_stack.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Flat combining benchmark
+ *
+ * - Check first
+ *      - Threads increment the combining counter - the total must be exact
+ *      - Threads push distinct values onto the combining stack, then pop them all - each exactly once
+ *      - An exception thrown in an operation must reach the thread which called apply()
+ *        - Also when another thread ran the operation, in combine()
+ *
+ * - Then the same operations under high contention
+ *      - counter: combining_counter vs the atomic_flag spin lock from task(), a std::mutex,
+ *        and fetch_add() (lock-free)
+ *      - stack (push then pop): combining_stack vs a std::vector under a std::mutex,
+ *        and a Treiber stack (lock-free)
+ *      */
+
+// Thrown by an operation: who published it, and whether another thread (the combiner) ran it
+struct op_error {
+    int thread;
+    int op;
+    bool combined;
+};
+
+// Contended: every other operation throws, while other threads are combining
+bool check_exceptions()
+{
+    constexpr int n_threads = 8;
+    constexpr int n = 2'000;
+    flat_combiner<long> fc;
+    std::atomic<bool> ok{true};
+    std::atomic<long> combined{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            auto me = std::this_thread::get_id();
+            for (int i = 0; i < n; ++i) {
+                try {
+                    fc.apply([&, i](long &x) {
+                        ++x;
+                        // Hold the lock for a while, so the other threads publish their operations
+                        std::this_thread::yield();
+                        if (i % 2)
+                            throw op_error{t, i, std::this_thread::get_id() != me};
+                        return x;
+                    });
+                    if (i % 2)
+                        ok = false;
+                }
+                catch (const op_error &e) {
+                    if (e.thread != t || e.op != i)
+                        ok = false;
+                    if (e.combined)
+                        combined.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    // Some exceptions must have come through combine(), or the check proves nothing
+    std::printf("exceptions passed back from the combiner: %ld of %d\n", combined.load(), n_threads * n / 2);
+    return ok && combined > 0 && fc.apply([](long &x) { return x; }) == n_threads * n;
+}
+
+bool check()
+{
+    constexpr int n_threads = 8;
+    constexpr int n = 20'000;
+    std::vector<std::thread> threads;
+
+    combining_counter counter;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < n; ++i)
+                counter.add(1);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    threads.clear();
+    if (counter.get() != n_threads * n)
+        return false;
+
+    combining_stack<int> stack;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < n; ++i)
+                stack.push(t * n + i);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    threads.clear();
+
+    std::vector<std::atomic<int>> seen(n_threads * n);
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&] {
+            while (auto v = stack.pop())
+                seen[*v].fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    for (auto &s : seen) {
+        if (s.load() != 1)
+            return false;
+    }
+
+    flat_combiner<int> fc;
+    try {
+        fc.apply([](int &) -> int { throw 42; });
+        return false;
+    }
+    catch (int e) {
+        if (e != 42 || fc.apply([](int &x) { return ++x; }) != 1)
+            return false;
+    }
+    return check_exceptions();
+}
+
+combining_counter fc_counter;
+padded<std::atomic_flag> lock_cout;
+padded<long long> spin_counter{0};
+padded<std::mutex> counter_mut;
+padded<long long> mutex_counter{0};
+padded<std::atomic<long long>> atomic_counter{0};
+
+combining_stack<int> fc_stack;
+padded<std::mutex> stack_mut;
+std::vector<int> locked_stack;
+treiber_stack<int> lock_free_stack;
+
+int main(int argc, char *argv[])
+{
+    if (!check()) {
+        std::printf("check: FAILED\n");
+        return 1;
+    }
+    std::printf("check: ok\n");
+
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("flat_combining/counter", [](bench::context &) {
+        bench::do_not_optimize(fc_counter.add(1));
+    }).threads(thread_counts);
+
+    bench::add("atomic_flag_spin_lock/counter", [](bench::context &) {
+        while (lock_cout->test_and_set(std::memory_order_acquire)) {}
+        ++*spin_counter;
+        bench::clobber_memory();
+        lock_cout->clear(std::memory_order_release);
+    }).threads(thread_counts);
+
+    bench::add("mutex/counter", [](bench::context &) {
+        std::lock_guard<std::mutex> lg(*counter_mut);
+        ++*mutex_counter;
+        bench::clobber_memory();
+    }).threads(thread_counts);
+
+    bench::add("fetch_add/counter", [](bench::context &) {
+        bench::do_not_optimize(atomic_counter->fetch_add(1));
+    }).threads(thread_counts);
+
+    bench::add("flat_combining/stack", [](bench::context &ctx) {
+        fc_stack.push(ctx.thread_index);
+        bench::do_not_optimize(fc_stack.pop());
+    }).threads(thread_counts);
+
+    bench::add("mutex/stack", [](bench::context &ctx) {
+        {
+            std::lock_guard<std::mutex> lg(*stack_mut);
+            locked_stack.push_back(ctx.thread_index);
+        }
+        std::lock_guard<std::mutex> lg(*stack_mut);
+        bench::do_not_optimize(locked_stack.back());
+        locked_stack.pop_back();
+    }).threads(thread_counts);
+
+    bench::add("treiber_stack/stack", [](bench::context &ctx) {
+        lock_free_stack.push(ctx.thread_index);
+        bench::do_not_optimize(lock_free_stack.pop());
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
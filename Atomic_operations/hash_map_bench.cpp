@@ -0,0 +1,179 @@
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "concurrent_hash_map.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * concurrent_hash_map benchmark
+ *
+ * - Checks first
+ *      - Random operations on one thread, compared with std::unordered_map
+ *      - Readers look up a fixed set of keys while writers insert and erase other keys,
+ *        forcing resizes - every lookup must find the right value
+ *
+ * - Then throughput, with 64K keys of which half are present
+ *      - find: only lookups
+ *      - mixed: 90% lookups, 5% insert_or_assign, 5% erase
+ *      - concurrent_hash_map vs std::unordered_map under a std::shared_mutex
+ *      */
+
+constexpr long key_range = 65536;
+
+// Returns the number of mismatches
+long check_sequential()
+{
+    concurrent_hash_map<long, long> map(4);
+    std::unordered_map<long, long> reference;
+    std::minstd_rand rng(1);
+    long errors = 0;
+
+    for (int i = 0; i < 1'000'000; ++i) {
+        long key = long(rng() % 4096);
+        switch (rng() % 3) {
+        case 0:
+            if (map.insert_or_assign(key, i) != reference.insert_or_assign(key, i).second)
+                ++errors;
+            break;
+        case 1:
+            if (map.erase(key) != (reference.erase(key) == 1))
+                ++errors;
+            break;
+        default: {
+            auto it = reference.find(key);
+            auto v = map.find(key);
+            if (v.has_value() != (it != reference.end()) || (v && *v != it->second))
+                ++errors;
+        }
+        }
+    }
+    if (map.size() != reference.size())
+        ++errors;
+    return errors;
+}
+
+// Returns the number of lookups which did not find the right value
+long check_concurrent(int n_readers, int n_writers)
+{
+    concurrent_hash_map<long, long> map(4);
+    constexpr long n_fixed = 1024;
+    for (long k = 0; k < n_fixed; ++k)
+        map.insert_or_assign(k, k * 7);
+
+    std::atomic<bool> done{false};
+    std::atomic<long> errors{0};
+    std::vector<std::thread> threads;
+
+    for (int r = 0; r < n_readers; ++r) {
+        threads.emplace_back([&, r] {
+            std::minstd_rand rng(r + 1);
+            while (!done.load(std::memory_order_relaxed)) {
+                long k = long(rng() % n_fixed);
+                auto v = map.find(k);
+                if (!v || *v != k * 7)
+                    errors.fetch_add(1);
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < n_writers; ++w) {
+        writers.emplace_back([&, w] {
+            // Keys above n_fixed, different for each writer
+            long base = n_fixed + w * 100'000;
+            for (int round = 0; round < 4; ++round) {
+                for (long k = 0; k < 20'000; ++k)
+                    map.insert_or_assign(base + k, k);
+                for (long k = 0; k < 20'000; ++k)
+                    map.erase(base + k);
+            }
+        });
+    }
+    for (auto &w : writers)
+        w.join();
+
+    done = true;
+    for (auto &t : threads)
+        t.join();
+    if (map.size() != std::size_t(n_fixed))
+        errors.fetch_add(1);
+    return errors.load();
+}
+
+concurrent_hash_map<long, long> chm;
+
+padded<std::shared_mutex> shared_mut;
+std::unordered_map<long, long> locked_map;
+
+void populate()
+{
+    for (long k = 0; k < key_range; k += 2) {
+        chm.insert_or_assign(k, k);
+        locked_map.insert_or_assign(k, k);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long sequential_errors = check_sequential();
+    long concurrent_errors = check_concurrent(4, 2);
+    std::printf("check: %ld sequential errors, %ld concurrent errors\n", sequential_errors, concurrent_errors);
+    if (sequential_errors || concurrent_errors)
+        return 1;
+
+    populate();
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("concurrent_hash_map/find", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        bench::do_not_optimize(chm.find(long(rng() % key_range)));
+    }).threads(thread_counts);
+
+    bench::add("shared_mutex_map/find", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        std::shared_lock<std::shared_mutex> sl(*shared_mut);
+        auto it = locked_map.find(key);
+        bench::do_not_optimize(it == locked_map.end() ? std::optional<long>() : std::optional<long>(it->second));
+    }).threads(thread_counts);
+
+    bench::add("concurrent_hash_map/mixed", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        auto op = rng() % 20;
+        if (op == 0)
+            chm.insert_or_assign(key, key);
+        else if (op == 1)
+            chm.erase(key);
+        else
+            bench::do_not_optimize(chm.find(key));
+    }).threads(thread_counts);
+
+    bench::add("shared_mutex_map/mixed", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        auto op = rng() % 20;
+        if (op == 0) {
+            std::lock_guard<std::shared_mutex> lg(*shared_mut);
+            locked_map.insert_or_assign(key, key);
+        }
+        else if (op == 1) {
+            std::lock_guard<std::shared_mutex> lg(*shared_mut);
+            locked_map.erase(key);
+        }
+        else {
+            std::shared_lock<std::shared_mutex> sl(*shared_mut);
+            auto it = locked_map.find(key);
+            bench::do_not_optimize(it == locked_map.end() ? std::optional<long>() : std::optional<long>(it->second));
+        }
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,212 @@
+#ifndef HAZARD_POINTERS_H
+#define HAZARD_POINTERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "padded.h"
+
+/*
+ * Hazard Pointers
+ *
+ * - In a lock-free structure, one thread may remove a node while another is still reading it
+ *      - If the node is deleted straight away, the reader uses freed memory
+ *      - If the memory is reused for a new node at the same address, a CAS can succeed
+ *        when it should fail ("ABA problem")
+ *
+ * - Before reading a node, a thread publishes its address in a hazard pointer
+ *      - Then checks the node is still reachable - if not, try again
+ * - A removed node is "retired" rather than deleted
+ *      - Each thread keeps a list of the nodes it has retired
+ *      - When the list gets long, scan every thread's hazard pointers
+ *      - Delete the retired nodes which nobody is protecting
+ *
+ * - Memory use is bounded: at most (threads x hazard pointers) nodes cannot be freed
+ * - But every read of a node costs a store and a full fence
+ *
+ * - Reclamation policy interface (also used by epoch_reclamation.h)
+ *          hazard_pointers::guard g;           // One hazard pointer for this scope
+ *          node *p = g.protect(head);          // Load head and protect the node
+ *          ...
+ *          hazard_pointers::retire(p);         // Delete p when it is safe
+ *      */
+
+class hazard_pointers {
+public:
+    static constexpr std::size_t max_threads = 256;
+    static constexpr std::size_t slots_per_thread = 4;
+
+    // Owns one hazard pointer slot of the calling thread until destroyed
+    class guard {
+    public:
+        guard() : slot(local().acquire_slot()) {}
+
+        ~guard()
+        {
+            slot->store(nullptr, std::memory_order_release);
+            local().release_slot();
+        }
+
+        guard(const guard &) = delete;
+        guard &operator=(const guard &) = delete;
+
+        // Load src and protect the node it points to
+        // The node stays valid until reset(), another protect() or the end of the guard
+        template<typename T>
+        T *protect(const std::atomic<T *> &src) noexcept
+        {
+            T *p = src.load(std::memory_order_relaxed);
+            while (true) {
+                slot->store(p, std::memory_order_seq_cst);
+                T *q = src.load(std::memory_order_seq_cst);
+                if (q == p)
+                    return p;
+                p = q;
+            }
+        }
+
+        void reset() noexcept { slot->store(nullptr, std::memory_order_release); }
+
+    private:
+        std::atomic<void *> *slot;
+    };
+
+    // Delete p once no hazard pointer refers to it
+    template<typename T>
+    static void retire(T *p)
+    {
+        local().retire(p, [](void *q) { delete static_cast<T *>(q); });
+    }
+
+    // Try to free this thread's retired nodes now
+    static void collect() { local().scan(); }
+
+private:
+    struct retired_node {
+        void *pointer;
+        void (*deleter)(void *);
+    };
+
+    struct record {
+        std::atomic<bool> active{false};
+        std::atomic<void *> hazards[slots_per_thread];
+    };
+
+    struct domain {
+        padded<record> records[max_threads];
+        std::mutex orphans_mut;
+        std::vector<retired_node> orphans;      // Left behind by threads which have exited
+
+        // Only runs at program exit, when no thread can hold a hazard pointer
+        ~domain()
+        {
+            for (auto &n : orphans)
+                n.deleter(n.pointer);
+        }
+    };
+
+    static domain &global()
+    {
+        static domain d;
+        return d;
+    }
+
+    // Per-thread state: this thread's record and its retired nodes
+    class thread_state {
+    public:
+        thread_state()
+        {
+            auto &d = global();
+            for (auto &r : d.records) {
+                bool expected = false;
+                if (!r->active.load(std::memory_order_relaxed)
+                    && r->active.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    rec = &r.value;
+                    return;
+                }
+            }
+            throw std::runtime_error("hazard_pointers: too many threads");
+        }
+
+        ~thread_state()
+        {
+            scan();
+            if (!retired.empty()) {
+                auto &d = global();
+                std::lock_guard<std::mutex> lg(d.orphans_mut);
+                d.orphans.insert(d.orphans.end(), retired.begin(), retired.end());
+            }
+            rec->active.store(false, std::memory_order_release);
+        }
+
+        std::atomic<void *> *acquire_slot()
+        {
+            if (used == slots_per_thread)
+                throw std::logic_error("hazard_pointers: too many guards in one thread");
+            return &rec->hazards[used++];
+        }
+
+        void release_slot() noexcept { --used; }
+
+        void retire(void *p, void (*deleter)(void *))
+        {
+            retired.push_back({p, deleter});
+            if (retired.size() >= threshold())
+                scan();
+        }
+
+        void scan()
+        {
+            auto &d = global();
+
+            // Adopt nodes from threads which have exited
+            {
+                std::unique_lock<std::mutex> ul(d.orphans_mut, std::try_to_lock);
+                if (ul.owns_lock() && !d.orphans.empty()) {
+                    retired.insert(retired.end(), d.orphans.begin(), d.orphans.end());
+                    d.orphans.clear();
+                }
+            }
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::vector<void *> hazards;
+            for (auto &r : d.records) {
+                if (!r->active.load(std::memory_order_acquire))
+                    continue;
+                for (auto &h : r->hazards) {
+                    if (void *p = h.load(std::memory_order_seq_cst))
+                        hazards.push_back(p);
+                }
+            }
+            std::sort(hazards.begin(), hazards.end());
+
+            std::vector<retired_node> keep;
+            for (auto &n : retired) {
+                if (std::binary_search(hazards.begin(), hazards.end(), n.pointer))
+                    keep.push_back(n);
+                else
+                    n.deleter(n.pointer);
+            }
+            retired.swap(keep);
+        }
+
+    private:
+        // Every scan reads all the hazard pointers, so only scan after a batch of retires
+        static std::size_t threshold() { return 2 * slots_per_thread * 64; }
+
+        record *rec = nullptr;
+        std::size_t used = 0;
+        std::vector<retired_node> retired;
+    };
+
+    static thread_state &local()
+    {
+        thread_local thread_state state;
+        return state;
+    }
+};
+
+#endif //HAZARD_POINTERS_H
@@ -0,0 +1,63 @@
+#ifndef HYBRID_FLAG_LOCK_H
+#define HYBRID_FLAG_LOCK_H
+
+#include <atomic>
+#include "backoff.h"
+
+/*
+ * Hybrid Flag Lock
+ *
+ * - The spin lock in task() keeps spinning for the whole critical section
+ *      - 50ms of sleep_for() in the critical section = 50ms of wasted CPU per waiter
+ *
+ * - C++20 adds wait() and notify_one() to std::atomic_flag
+ *      - lock_cout.wait(true) blocks until the flag is no longer true
+ *      - The thread sleeps in the kernel (futex on Linux) instead of spinning
+ *
+ * - Hybrid: spin for a short time, then sleep
+ *      - Short critical sections: the lock is usually free again before we give up spinning
+ *      - Long critical sections: waiters use no CPU
+ *
+ * - Works with std::lock_guard, because it has lock() and unlock()
+ *          hybrid_flag_lock lock_cout;
+ *          std::lock_guard<hybrid_flag_lock> lg(lock_cout);
+ *      */
+
+class hybrid_flag_lock {
+public:
+    explicit hybrid_flag_lock(int spin_limit = 100) noexcept : spin_limit(spin_limit) {}
+
+    hybrid_flag_lock(const hybrid_flag_lock &) = delete;
+    hybrid_flag_lock &operator=(const hybrid_flag_lock &) = delete;
+
+    void lock() noexcept
+    {
+        // Spin for a while - only try to set the flag when it looks clear
+        for (int i = 0; i < spin_limit; ++i) {
+            if (!flag.test(std::memory_order_relaxed) && !flag.test_and_set(std::memory_order_acquire))
+                return;
+            cpu_relax();
+        }
+
+        // Then sleep until the flag is cleared
+        while (flag.test_and_set(std::memory_order_acquire))
+            flag.wait(true, std::memory_order_relaxed);
+    }
+
+    bool try_lock() noexcept
+    {
+        return !flag.test(std::memory_order_relaxed) && !flag.test_and_set(std::memory_order_acquire);
+    }
+
+    void unlock() noexcept
+    {
+        flag.clear(std::memory_order_release);
+        flag.notify_one();
+    }
+
+private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+    int spin_limit;
+};
+
+#endif //HYBRID_FLAG_LOCK_H
@@ -0,0 +1,66 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "hybrid_flag_lock.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Spin lock vs hybrid flag lock vs mutex
+ *
+ * - Like task(), the critical section sleeps - here for 100us instead of 50ms
+ * - Throughput is about the same for all three
+ *      - Only one thread can be in the critical section
+ * - cpu_utilization shows what the waiters cost
+ *      - Spinning waiters use a whole core each
+ *      - Waiters on the hybrid lock or the mutex sleep
+ *
+ * - The "short" versions have an empty critical section, where spinning pays off
+ *      */
+
+using namespace std::literals;
+
+padded<std::atomic_flag> lock_cout;
+padded<hybrid_flag_lock> hybrid_lock;
+padded<std::mutex> mut;
+padded<long long> shared_counter{0};
+
+int main(int argc, char *argv[])
+{
+    const int threads = std::max(4, bench::hardware_threads());
+
+    bench::add("spin_lock/sleeping_section", [](bench::context &) {
+        while (lock_cout->test_and_set()) {}
+        std::this_thread::sleep_for(100us);
+        lock_cout->clear();
+    }).threads_range(threads).instrument_with(bench::cpu_time_instrument::make);
+
+    bench::add("hybrid_flag_lock/sleeping_section", [](bench::context &) {
+        std::lock_guard<hybrid_flag_lock> lg(*hybrid_lock);
+        std::this_thread::sleep_for(100us);
+    }).threads_range(threads).instrument_with(bench::cpu_time_instrument::make);
+
+    bench::add("mutex/sleeping_section", [](bench::context &) {
+        std::lock_guard<std::mutex> lg(*mut);
+        std::this_thread::sleep_for(100us);
+    }).threads_range(threads).instrument_with(bench::cpu_time_instrument::make);
+
+    bench::add("spin_lock/short_section", [](bench::context &) {
+        while (lock_cout->test_and_set()) {}
+        ++*shared_counter;
+        lock_cout->clear();
+    }).threads_range(threads).instrument_with(bench::cpu_time_instrument::make);
+
+    bench::add("hybrid_flag_lock/short_section", [](bench::context &) {
+        std::lock_guard<hybrid_flag_lock> lg(*hybrid_lock);
+        ++*shared_counter;
+    }).threads_range(threads).instrument_with(bench::cpu_time_instrument::make);
+
+    bench::add("mutex/short_section", [](bench::context &) {
+        std::lock_guard<std::mutex> lg(*mut);
+        ++*shared_counter;
+    }).threads_range(threads).instrument_with(bench::cpu_time_instrument::make);
+
+    return bench::run(argc, argv);
+}
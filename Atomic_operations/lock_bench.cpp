@@ -0,0 +1,35 @@
+#include <atomic>
+#include <mutex>
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Spin lock vs mutex
+ *
+ * - The same very short critical section, protected by
+ *      - The std::atomic_flag spin lock from task()
+ *      - The std::mutex from task_m()
+ * - Run with 1, 2, 4 ... threads to see the effect of contention
+ *      */
+
+padded<std::atomic_flag> lock_cout;
+padded<std::mutex> mut;
+padded<long long> shared_counter{0};
+
+int main(int argc, char *argv[])
+{
+    bench::add("atomic_flag_spin_lock", [](bench::context &) {
+        while (lock_cout->test_and_set()) {}
+        ++*shared_counter;
+        bench::clobber_memory();
+        lock_cout->clear();
+    }).threads_range(bench::hardware_threads());
+
+    bench::add("mutex", [](bench::context &) {
+        std::lock_guard<std::mutex> lg(*mut);
+        ++*shared_counter;
+        bench::clobber_memory();
+    }).threads_range(bench::hardware_threads());
+
+    return bench::run(argc, argv);
+}
@@ -3,6 +3,9 @@
 #include <atomic>
 #include <vector>
 #include <chrono>
+#include <mutex>
+#include "padded.h"
+#include "hybrid_flag_lock.h"
 
 /*
  * - Member Functions for Atomic Types
@@ -27,9 +30,12 @@
  *      - fetch_add() synonym for x++
  *      - fetch_sub() synonym for x--
  *      - += and -= operators
+ *      - compare_exchange on a pointer cannot tell if it was changed and then changed back
+ *        ("ABA problem") - see tagged_ptr.h
  *
  * - Integer specializations have these, plus
  *      - Atomic bitwise logical operations &, | and ^
+ *      - fetch_or() and fetch_and() can claim and release single bits - see atomic_bitmap.h
  *      */
 
 /*
@@ -113,6 +119,28 @@
  * - This gives better performance than the conventional implementation
  * */
 
+/*
+ * Hybrid Flag Lock (hybrid_flag_lock.h)
+ * - C++20 adds wait() and notify_one() to std::atomic_flag
+ * - Spin for a short time, then call lock_cout.wait(true)
+ *      - The waiting thread sleeps instead of using a whole core
+ *      - unlock() clears the flag and calls notify_one()
+ *      */
+
+/*
+ * Flat Combining (flat_combining.h)
+ * - With many threads, every lock_cout.test_and_set() moves the flag's cache line to another core
+ * - Instead, threads publish their operations, and whichever thread gets the lock runs them all
+ *      - One lock acquisition and one set of cache line transfers for a whole batch
+ *      */
+
+/*
+ * Cohort Lock (cohort_lock.h)
+ * - On a machine with several sockets, mut and lock_cout may be handed to a thread on the other socket
+ * - A cohort lock prefers to hand over to a waiting thread on the same NUMA node
+ *      - Up to a limit, so that threads on other nodes still get a turn
+ *      */
+
 /*
  * Lock-free Programming
  *
@@ -227,6 +255,7 @@
  * - Put shared data in transactional memory
  * - All operations on shared data will be transactional
  * - However, there is no standard implementation in C++
+ *      - stm.h is a small word-based one: atomically([&](tx &t) { ... })
  * */
 
 /*
@@ -259,8 +288,9 @@
 
 
 
-// The atomic_flag must be initialized as false
-std::atomic_flag lock_cout = ATOMIC_FLAG_INIT;
+// The atomic_flag must be initialized as false (the C++20 default constructor does this)
+// padded fills a whole cache line, so it cannot share one with mut (padded.h)
+padded<std::atomic_flag> lock_cout;
 
 void task(int n)
 {
@@ -268,7 +298,7 @@ void task(int n)
     // Returns true if another thread set the flag
     // Returns false if this thread set the flag
 
-    while(lock_cout.test_and_set()) {}
+    while(lock_cout->test_and_set()) {}
 
     // Start of critical section
     // do some work
@@ -278,15 +308,15 @@ void task(int n)
     // End of critical section
 
     // Clear the flag, so another thread can set it
-    lock_cout.clear();
+    lock_cout->clear();
 
 }
 
 // same code utilizing a mutex
-std::mutex mut;
+padded<std::mutex> mut;
 void task_m(int n)
 {
-    std::lock_guard<std::mutex> lg(mut);
+    std::lock_guard<std::mutex> lg(*mut);
 
     // Start of critical sections
     // do some work
@@ -295,6 +325,20 @@ void task_m(int n)
     std::cout << "I'm a task with argument " << n << std::endl;
     // End of critical section
 }
+
+// same code utilizing the hybrid flag lock
+padded<hybrid_flag_lock> lock_hybrid;
+void task_h(int n)
+{
+    std::lock_guard<hybrid_flag_lock> lg(*lock_hybrid);
+
+    // Start of critical section
+    // do some work
+    using namespace std::literals;
+    std::this_thread::sleep_for(50ms);
+    std::cout << "I'm a task with argument " << n << std::endl;
+    // End of critical section
+}
 int main() {
 //    std::cout << "Hello, World!" << std::endl;
 //
@@ -0,0 +1,216 @@
+#ifndef MULTI_QUEUE_H
+#define MULTI_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "backoff.h"
+#include "padded.h"
+
+/*
+ * Multi-Queue - a relaxed concurrent priority queue
+ *
+ * - A timer or scheduler needs "give me the task with the earliest deadline"
+ *      - std::priority_queue under one mutex: every push and pop contends for the lock
+ *      - An exact concurrent priority queue must always hand out the single minimum,
+ *        so every pop fights over the same element
+ *
+ * - Relax the guarantee: pop an element close to the minimum
+ *      - Keep several binary heaps, each with its own try-lock (2 per hardware thread by default)
+ *      - push(): lock a random heap and push - if its lock is taken, try another one
+ *      - pop_min(): look at the tops of two random heaps, lock the one with the smaller top and pop
+ *      - The element popped is usually among the smallest (a few x number of heaps)
+ *
+ * - Each heap publishes its top priority in an atomic, so choosing a heap needs no lock
+ *      - So the priority must be arithmetic - e.g. a deadline in nanoseconds
+ *
+ * - priority_queue_mode::exact
+ *      - pop_min() locks every heap and takes the true minimum
+ *      - Slow, but lets tests compare against std::priority_queue
+ *
+ *          multi_queue<std::int64_t, task *> timers;
+ *          timers.push(deadline, t);
+ *          if (auto next = timers.pop_min()) ...next->first is the deadline, next->second the task
+ *      */
+
+enum class priority_queue_mode { relaxed, exact };
+
+template<typename P, typename V>
+class multi_queue {
+    static_assert(std::is_arithmetic_v<P>, "multi_queue priorities must be arithmetic");
+
+public:
+    using value_type = std::pair<P, V>;
+
+    explicit multi_queue(priority_queue_mode mode = priority_queue_mode::relaxed, std::size_t n_queues = 0)
+        : mode(mode),
+          n_queues(n_queues > 0 ? n_queues : 2 * std::max(1u, std::thread::hardware_concurrency())),
+          queues(new padded<heap>[this->n_queues]) {}
+
+    multi_queue(const multi_queue &) = delete;
+    multi_queue &operator=(const multi_queue &) = delete;
+
+    void push(P priority, V value)
+    {
+        backoff b;
+        while (true) {
+            heap &h = *queues[random_index()];
+            if (h.try_lock()) {
+                h.push(priority, std::move(value));
+                h.unlock();
+                return;
+            }
+            b.pause();
+        }
+    }
+
+    std::optional<value_type> pop_min()
+    {
+        return mode == priority_queue_mode::exact ? pop_exact() : pop_relaxed();
+    }
+
+    // Only exact when no other thread is pushing or popping
+    bool empty() const noexcept
+    {
+        for (std::size_t i = 0; i < n_queues; ++i) {
+            if (queues[i]->count.load(std::memory_order_relaxed) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < n_queues; ++i)
+            n += queues[i]->count.load(std::memory_order_relaxed);
+        return n;
+    }
+
+private:
+    // An empty heap has this as its top, so it is not chosen over a heap with elements
+    // Emptiness itself is decided by count, so elements may still use this priority
+    static constexpr P empty_top = std::numeric_limits<P>::max();
+
+    struct heap {
+        std::atomic<bool> locked{false};
+        std::atomic<P> top{empty_top};
+        std::atomic<std::size_t> count{0};
+        std::vector<value_type> elements;       // Min-heap, only used under the lock
+
+        bool try_lock() noexcept
+        {
+            return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void lock() noexcept
+        {
+            backoff b;
+            while (!try_lock())
+                b.pause();
+        }
+
+        void unlock() noexcept { locked.store(false, std::memory_order_release); }
+
+        static bool later(const value_type &a, const value_type &b) noexcept { return a.first > b.first; }
+
+        void push(P priority, V value)
+        {
+            elements.emplace_back(priority, std::move(value));
+            std::push_heap(elements.begin(), elements.end(), later);
+            publish();
+        }
+
+        value_type pop()
+        {
+            std::pop_heap(elements.begin(), elements.end(), later);
+            value_type v = std::move(elements.back());
+            elements.pop_back();
+            publish();
+            return v;
+        }
+
+        void publish() noexcept
+        {
+            top.store(elements.empty() ? empty_top : elements.front().first, std::memory_order_relaxed);
+            count.store(elements.size(), std::memory_order_relaxed);
+        }
+    };
+
+    std::size_t random_index() const noexcept
+    {
+        thread_local std::uint64_t state = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<std::uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return std::size_t((state >> 32) * n_queues >> 32);
+    }
+
+    std::optional<value_type> pop_relaxed()
+    {
+        backoff b;
+        int misses = 0;
+        while (true) {
+            auto i = random_index();
+            auto j = random_index();
+            heap *h = &*queues[i];
+            heap *other = &*queues[j];
+            if (other->top.load(std::memory_order_relaxed) < h->top.load(std::memory_order_relaxed))
+                std::swap(h, other);
+
+            if (h->count.load(std::memory_order_relaxed) == 0) {
+                // Both look empty - after a few tries, check every heap
+                if (++misses >= 4) {
+                    if (empty())
+                        return std::nullopt;
+                    misses = 0;
+                }
+                continue;
+            }
+
+            if (h->try_lock()) {
+                if (!h->elements.empty()) {
+                    auto v = h->pop();
+                    h->unlock();
+                    return v;
+                }
+                h->unlock();
+            }
+            b.pause();
+        }
+    }
+
+    std::optional<value_type> pop_exact()
+    {
+        for (std::size_t i = 0; i < n_queues; ++i)
+            queues[i]->lock();
+
+        heap *best = nullptr;
+        for (std::size_t i = 0; i < n_queues; ++i) {
+            heap &h = *queues[i];
+            if (!h.elements.empty() && (!best || h.elements.front().first < best->elements.front().first))
+                best = &h;
+        }
+        std::optional<value_type> v;
+        if (best)
+            v = best->pop();
+
+        for (std::size_t i = 0; i < n_queues; ++i)
+            queues[i]->unlock();
+        return v;
+    }
+
+    priority_queue_mode mode;
+    std::size_t n_queues;
+    std::unique_ptr<padded<heap>[]> queues;
+};
+
+#endif //MULTI_QUEUE_H
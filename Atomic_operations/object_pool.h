@@ -0,0 +1,310 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include "tagged_ptr.h"
+
+/*
+ * Object Pool with Magazines
+ *
+ * - Every task object, std::promise shared state, ... goes through operator new and delete
+ *      - A general purpose allocator has to handle every size, and threads share its data structures
+ *
+ * - A pool only hands out objects of one type
+ *      - Freed objects are kept, and reused for the next allocation
+ *
+ * - Per-thread caches ("magazines")
+ *      - A magazine is an array of up to 64 free objects
+ *      - Each thread has two: allocate() pops from the loaded one, free() pushes onto it
+ *      - When the loaded magazine is empty (or full), swap it with the other one
+ *      - Most calls touch nothing but this thread's cache - no atomics, no sharing
+ *
+ * - The depot
+ *      - Lock-free stacks of full and empty magazines, shared by all threads
+ *      - Only used when both of a thread's magazines are empty (or both full)
+ *      - The stacks use tagged_stack, so magazines can be reused without ABA problems
+ *      - A thread which allocates more than it frees gets new objects in blocks of 64
+ *
+ * - An object freed by another thread goes into the freeing thread's cache
+ *      - With producer/consumer threads, full magazines flow back through the depot
+ *
+ * - Objects may be freed during static destruction
+ *      - A thread's cache is destroyed before static objects are (thread_local destructors run first)
+ *      - After that, the thread's objects go to and come from a list in the depot, under its mutex
+ *      - The depot itself is never destroyed: pool memory is only given back to the system when the process exits
+ *
+ * - Freeing never allocates memory
+ *      - If a new magazine cannot be allocated, the object goes onto the depot's list instead
+ *
+ *          task *t = object_pool<task>::create(args...);
+ *          object_pool<task>::destroy(t);
+ *
+ *          // Shared state of a std::promise from a pool
+ *          std::promise<int> p(std::allocator_arg, pool_allocator<int>());
+ *      */
+
+template<typename T>
+class object_pool {
+public:
+    static constexpr std::size_t magazine_size = 64;
+
+    template<typename... Args>
+    static T *create(Args &&...args)
+    {
+        void *p = allocate();
+        try {
+            return new (p) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            deallocate(p);
+            throw;
+        }
+    }
+
+    static void destroy(T *p) noexcept
+    {
+        if (p) {
+            p->~T();
+            deallocate(p);
+        }
+    }
+
+    // Uninitialized storage for one T
+    static void *allocate()
+    {
+        if (cache_destroyed())
+            return global().pop_loose();
+        return local().allocate();
+    }
+
+    static void deallocate(void *p) noexcept
+    {
+        if (cache_destroyed())
+            global().push_loose(p);
+        else
+            local().deallocate(p);
+    }
+
+private:
+    struct magazine {
+        std::atomic<magazine *> next{nullptr};      // For the depot's stacks
+        std::size_t count = 0;
+        void *objects[magazine_size];
+
+        bool empty() const noexcept { return count == 0; }
+        bool full() const noexcept { return count == magazine_size; }
+        void *pop() noexcept { return objects[--count]; }
+        void push(void *p) noexcept { objects[count++] = p; }
+    };
+
+    // Room for a T, or for the free list link when it is not in use
+    static constexpr std::size_t object_align = std::max(alignof(T), alignof(void *));
+    static constexpr std::size_t object_size = (std::max(sizeof(T), sizeof(void *)) + object_align - 1) / object_align * object_align;
+
+    struct depot {
+        tagged_stack<magazine> full;
+        tagged_stack<magazine> empty;
+
+        // Slow path: new magazines and blocks of objects
+        magazine *new_magazine()
+        {
+            if (magazine *m = empty.pop())
+                return m;
+            std::lock_guard<std::mutex> lg(mut);
+            magazines.push_back(std::make_unique<magazine>());
+            return magazines.back().get();
+        }
+
+        void fill(magazine &m)
+        {
+            auto *block = new_block();
+            for (std::size_t i = 0; i < magazine_size; ++i)
+                m.push(block + i * object_size);
+        }
+
+        // Free objects outside any magazine, linked through their own storage
+        void push_loose(void *p) noexcept
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            *static_cast<void **>(p) = loose;
+            loose = p;
+        }
+
+        // nullptr if the list is empty
+        void *try_pop_loose() noexcept
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            return pop_loose_locked();
+        }
+
+        // Allocates a new block if the list is empty
+        void *pop_loose()
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            if (!loose) {
+                auto *block = new_block_locked();
+                for (std::size_t i = 0; i < magazine_size; ++i) {
+                    *reinterpret_cast<void **>(block + i * object_size) = loose;
+                    loose = block + i * object_size;
+                }
+            }
+            return pop_loose_locked();
+        }
+
+        void *pop_loose_locked() noexcept
+        {
+            void *p = loose;
+            if (p)
+                loose = *static_cast<void **>(p);
+            return p;
+        }
+
+        std::byte *new_block()
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            return new_block_locked();
+        }
+
+        std::byte *new_block_locked()
+        {
+            // Make room first, so push_back() cannot throw after the block is allocated
+            if (blocks.size() == blocks.capacity())
+                blocks.reserve(2 * blocks.size() + 16);
+            auto *block = static_cast<std::byte *>(::operator new(object_size * magazine_size, std::align_val_t(object_align)));
+            blocks.push_back(block);
+            return block;
+        }
+
+        std::mutex mut;
+        std::vector<std::unique_ptr<magazine>> magazines;
+        std::vector<std::byte *> blocks;
+        void *loose = nullptr;
+    };
+
+    static depot &global()
+    {
+        static depot *d = new depot;
+        return *d;
+    }
+
+    class cache {
+    public:
+        cache() : loaded(global().new_magazine()), previous(global().new_magazine()) {}
+
+        // Give this thread's objects to the depot, for other threads to use
+        ~cache()
+        {
+            cache_destroyed() = true;
+            auto &d = global();
+            for (magazine *m : {loaded, previous})
+                (m->empty() ? d.empty : d.full).push(m);
+        }
+
+        void *allocate()
+        {
+            if (!loaded->empty())
+                return loaded->pop();
+            if (!previous->empty()) {
+                std::swap(loaded, previous);
+                return loaded->pop();
+            }
+
+            auto &d = global();
+            if (magazine *m = d.full.pop()) {
+                d.empty.push(previous);
+                previous = loaded;
+                loaded = m;
+            }
+            else if (void *p = d.try_pop_loose()) {
+                return p;
+            }
+            else {
+                d.fill(*loaded);
+            }
+            return loaded->pop();
+        }
+
+        void deallocate(void *p) noexcept
+        {
+            if (!loaded->full()) {
+                loaded->push(p);
+                return;
+            }
+            if (!previous->full()) {
+                std::swap(loaded, previous);
+                loaded->push(p);
+                return;
+            }
+
+            auto &d = global();
+            magazine *m;
+            try {
+                m = d.new_magazine();
+            }
+            catch (...) {
+                // Out of memory: keep the object without a magazine
+                d.push_loose(p);
+                return;
+            }
+            d.full.push(previous);
+            previous = loaded;
+            loaded = m;
+            loaded->push(p);
+        }
+
+    private:
+        magazine *loaded;
+        magazine *previous;
+    };
+
+    static cache &local()
+    {
+        thread_local cache c;
+        return c;
+    }
+
+    // Set when this thread's cache has been destroyed - a bool has no destructor, so it lasts until the thread ends
+    static bool &cache_destroyed() noexcept
+    {
+        thread_local bool destroyed = false;
+        return destroyed;
+    }
+};
+
+// Allocator for single objects from object_pool - e.g. for std::allocate_shared or std::promise
+// Arrays go to operator new
+template<typename T>
+struct pool_allocator {
+    using value_type = T;
+
+    pool_allocator() noexcept = default;
+    template<typename U>
+    pool_allocator(const pool_allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(object_pool<T>::allocate());
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        if (n == 1)
+            object_pool<T>::deallocate(p);
+        else
+            std::allocator<T>().deallocate(p, n);
+    }
+
+    template<typename U>
+    bool operator==(const pool_allocator<U> &) const noexcept { return true; }
+};
+
+#endif //OBJECT_POOL_H
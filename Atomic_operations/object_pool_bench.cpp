@@ -0,0 +1,139 @@
+#include <atomic>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "object_pool.h"
+#include "benchmark.h"
+
+/*
+ * object_pool benchmark
+ *
+ * - Check first
+ *      - A producer thread creates objects, consumer threads destroy them
+ *      - Then every thread allocates a batch - no object may be handed out twice
+ *      - Some objects are kept until static destruction, after main()'s cache is gone
+ *
+ * - Then throughput
+ *      - create/destroy: one task object at a time
+ *      - batch: create 256 task objects, then destroy them all (uses the depot)
+ *      - promise: std::promise<int> whose shared state comes from the pool
+ *      - object_pool vs new and delete
+ *      */
+
+struct task_object {
+    int id;
+    char payload[60];
+};
+
+// Destroys its objects during static destruction, after the main thread's cache has been destroyed
+struct late_objects {
+    std::vector<task_object *> objects;
+
+    ~late_objects()
+    {
+        for (auto *t : objects)
+            object_pool<task_object>::destroy(t);
+        // Allocating this late must work too
+        object_pool<task_object>::destroy(object_pool<task_object>::create(task_object{-1, {}}));
+    }
+} late;
+
+bool check()
+{
+    constexpr int n = 100'000;
+    std::vector<std::atomic<task_object *>> handoff(n);
+
+    std::thread producer([&] {
+        for (int i = 0; i < n; ++i)
+            handoff[i].store(object_pool<task_object>::create(task_object{i, {}}), std::memory_order_release);
+    });
+
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 2; ++c) {
+        consumers.emplace_back([&, c] {
+            for (int i = c; i < n; i += 2) {
+                task_object *t;
+                while (!(t = handoff[i].load(std::memory_order_acquire)))
+                    std::this_thread::yield();
+                if (t->id != i)
+                    ok = false;
+                object_pool<task_object>::destroy(t);
+            }
+        });
+    }
+    producer.join();
+    for (auto &c : consumers)
+        c.join();
+
+    // Every live object must be distinct
+    std::vector<task_object *> live;
+    for (int i = 0; i < 10'000; ++i)
+        live.push_back(object_pool<task_object>::create(task_object{i, {}}));
+    for (int i = 0; i < 10'000; ++i) {
+        if (live[i]->id != i)
+            ok = false;
+        if (i % 100 == 0)
+            late.objects.push_back(live[i]);
+        else
+            object_pool<task_object>::destroy(live[i]);
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!check()) {
+        std::printf("check: FAILED\n");
+        return 1;
+    }
+    std::printf("check: ok\n");
+
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("object_pool/create_destroy", [](bench::context &ctx) {
+        auto *t = object_pool<task_object>::create(task_object{ctx.thread_index, {}});
+        bench::do_not_optimize(t);
+        object_pool<task_object>::destroy(t);
+    }).threads(thread_counts);
+
+    bench::add("new_delete/create_destroy", [](bench::context &ctx) {
+        auto *t = new task_object{ctx.thread_index, {}};
+        bench::do_not_optimize(t);
+        delete t;
+    }).threads(thread_counts);
+
+    bench::add("object_pool/batch", [](bench::context &ctx) {
+        task_object *batch[256];
+        for (auto &t : batch)
+            t = object_pool<task_object>::create(task_object{ctx.thread_index, {}});
+        bench::clobber_memory();
+        for (auto *t : batch)
+            object_pool<task_object>::destroy(t);
+    }).threads(thread_counts);
+
+    bench::add("new_delete/batch", [](bench::context &ctx) {
+        task_object *batch[256];
+        for (auto &t : batch)
+            t = new task_object{ctx.thread_index, {}};
+        bench::clobber_memory();
+        for (auto *t : batch)
+            delete t;
+    }).threads(thread_counts);
+
+    bench::add("object_pool/promise", [](bench::context &ctx) {
+        std::promise<int> p(std::allocator_arg, pool_allocator<int>());
+        p.set_value(ctx.thread_index);
+        bench::do_not_optimize(p.get_future().get());
+    }).threads(thread_counts);
+
+    bench::add("new_delete/promise", [](bench::context &ctx) {
+        std::promise<int> p;
+        p.set_value(ctx.thread_index);
+        bench::do_not_optimize(p.get_future().get());
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <numeric>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+#include "multi_queue.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * multi_queue benchmark
+ *
+ * - Checks first
+ *      - Exact mode: draining the queue gives the priorities in order
+ *      - Relaxed mode: "rank error" of each pop - how many smaller priorities were still queued
+ *      - Both modes: threads push and pop concurrently, nothing is lost or duplicated
+ *
+ * - Then throughput: each operation pushes a random priority and pops the minimum
+ *      - The queue starts with 4096 elements
+ *      - multi_queue (relaxed and exact) vs std::priority_queue under a std::mutex
+ *      */
+
+using queue_type = multi_queue<long, long>;
+
+// Returns false if the priorities do not come out in order
+bool check_exact_order()
+{
+    queue_type q(priority_queue_mode::exact, 8);
+    std::minstd_rand rng(1);
+    for (int i = 0; i < 100'000; ++i)
+        q.push(long(rng() % 1'000'000), i);
+
+    long last = -1;
+    while (auto v = q.pop_min()) {
+        if (v->first < last)
+            return false;
+        last = v->first;
+    }
+    return true;
+}
+
+// Fill with 0 .. n-1 in random order, drain, and report the mean and max rank error
+void rank_error(std::size_t n_queues, double &mean, long &max)
+{
+    constexpr long n = 1 << 16;
+    queue_type q(priority_queue_mode::relaxed, n_queues);
+    std::vector<long> priorities(n);
+    std::iota(priorities.begin(), priorities.end(), 0);
+    std::shuffle(priorities.begin(), priorities.end(), std::minstd_rand(2));
+    for (auto p : priorities)
+        q.push(p, p);
+
+    // Fenwick tree of the priorities still queued
+    std::vector<long> tree(n + 1, 0);
+    auto add = [&](long i, long d) { for (++i; i <= n; i += i & -i) tree[i] += d; };
+    auto smaller = [&](long i) { long s = 0; for (; i > 0; i -= i & -i) s += tree[i]; return s; };
+    for (long i = 0; i < n; ++i)
+        add(i, 1);
+
+    long total = 0;
+    max = 0;
+    while (auto v = q.pop_min()) {
+        long error = smaller(v->first);
+        total += error;
+        max = std::max(max, error);
+        add(v->first, -1);
+    }
+    mean = double(total) / n;
+}
+
+// Returns false if an element was lost or duplicated
+bool check_concurrent(priority_queue_mode mode)
+{
+    queue_type q(mode, 8);
+    constexpr int n_threads = 4;
+    constexpr long per_thread = 50'000;
+    std::atomic<long> popped_sum{0}, popped_count{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            std::minstd_rand rng(t + 1);
+            long sum = 0, count = 0;
+            for (long i = 0; i < per_thread; ++i) {
+                q.push(long(rng() % 1000), t * per_thread + i);
+                if (i % 2 == 0) {
+                    if (auto v = q.pop_min()) {
+                        sum += v->second;
+                        ++count;
+                    }
+                }
+            }
+            popped_sum += sum;
+            popped_count += count;
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    while (auto v = q.pop_min()) {
+        popped_sum += v->second;
+        ++popped_count;
+    }
+    long n = n_threads * per_thread;
+    return popped_count == n && popped_sum == n * (n - 1) / 2;
+}
+
+queue_type relaxed_queue(priority_queue_mode::relaxed);
+queue_type exact_queue(priority_queue_mode::exact);
+
+padded<std::mutex> mut;
+std::priority_queue<std::pair<long, long>, std::vector<std::pair<long, long>>, std::greater<>> locked_queue;
+
+int main(int argc, char *argv[])
+{
+    bool ok = check_exact_order();
+    ok = check_concurrent(priority_queue_mode::relaxed) && ok;
+    ok = check_concurrent(priority_queue_mode::exact) && ok;
+    std::printf("check: %s\n", ok ? "ok" : "FAILED");
+    if (!ok)
+        return 1;
+
+    for (std::size_t n_queues : {2, 8, 32}) {
+        double mean;
+        long max;
+        rank_error(n_queues, mean, max);
+        std::printf("relaxed, %zu heaps: mean rank error %.2f, max %ld\n", n_queues, mean, max);
+    }
+
+    std::minstd_rand rng(3);
+    for (long i = 0; i < 4096; ++i) {
+        long p = long(rng() % 1'000'000);
+        relaxed_queue.push(p, i);
+        exact_queue.push(p, i);
+        locked_queue.emplace(p, i);
+    }
+
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("multi_queue/relaxed", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        relaxed_queue.push(long(rng() % 1'000'000), ctx.thread_index);
+        bench::do_not_optimize(relaxed_queue.pop_min());
+    }).threads(thread_counts);
+
+    bench::add("multi_queue/exact", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        exact_queue.push(long(rng() % 1'000'000), ctx.thread_index);
+        bench::do_not_optimize(exact_queue.pop_min());
+    }).threads(thread_counts);
+
+    bench::add("mutex_priority_queue", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long p = long(rng() % 1'000'000);
+        std::pair<long, long> v;
+        {
+            std::lock_guard<std::mutex> lg(*mut);
+            locked_queue.emplace(p, ctx.thread_index);
+        }
+        {
+            std::lock_guard<std::mutex> lg(*mut);
+            v = locked_queue.top();
+            locked_queue.pop();
+        }
+        bench::do_not_optimize(v);
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
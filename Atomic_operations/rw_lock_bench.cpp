@@ -0,0 +1,70 @@
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include "rw_spin_lock.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Reader-writer spin lock vs std::shared_mutex
+ *
+ * - Shared state: a small struct, read under a shared lock, updated under an exclusive lock
+ * - 90% reads / 10% writes, and 99% reads / 1% writes
+ *      */
+
+struct shared_state {
+    long long values[4] = {0, 0, 0, 0};
+};
+
+padded<rw_spin_lock> rw_lock;
+padded<std::shared_mutex> shared_mut;
+padded<shared_state> state;
+
+// Cheap per-thread random numbers: xorshift
+inline std::uint32_t next_random()
+{
+    thread_local std::uint32_t x = 2463534242u ^ static_cast<std::uint32_t>(thread_slot() * 0x9e3779b9u);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+template<typename Lock>
+void read_or_write(Lock &lock, unsigned write_percent)
+{
+    if (next_random() % 100 < write_percent) {
+        std::unique_lock<Lock> ul(lock);
+        for (auto &v : state->values)
+            ++v;
+    }
+    else {
+        std::shared_lock<Lock> sl(lock);
+        long long sum = 0;
+        for (auto v : state->values)
+            sum += v;
+        bench::do_not_optimize(sum);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int threads = bench::hardware_threads();
+
+    for (unsigned write_percent : {10u, 1u}) {
+        char ratio[16];
+        std::snprintf(ratio, sizeof(ratio), "/%u_%u", 100 - write_percent, write_percent);
+
+        bench::add(std::string("rw_spin_lock") + ratio, [write_percent](bench::context &) {
+            read_or_write(*rw_lock, write_percent);
+        }).threads_range(threads);
+
+        bench::add(std::string("shared_mutex") + ratio, [write_percent](bench::context &) {
+            read_or_write(*shared_mut, write_percent);
+        }).threads_range(threads);
+    }
+
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,104 @@
+#ifndef RW_SPIN_LOCK_H
+#define RW_SPIN_LOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include "backoff.h"
+
+/*
+ * Reader-Writer Spin Lock
+ *
+ * - Most threads only read the shared state
+ *      - Readers can safely run at the same time as each other
+ *      - A writer needs exclusive access
+ *
+ * - All the state is in one atomic word
+ *      - bit 0         a writer holds the lock
+ *      - bit 1         a writer is waiting
+ *      - bits 2 ...    number of readers holding the lock
+ *
+ * - Writer preference
+ *      - A waiting writer sets bit 1
+ *      - New readers do not enter while bit 1 is set, so the readers drain
+ *      - Otherwise a steady stream of readers could keep a writer out forever
+ *
+ * - Has lock_shared() and unlock_shared(), so it works with std::shared_lock
+ *          rw_spin_lock rw;
+ *          std::shared_lock<rw_spin_lock> sl(rw);      // reader
+ *          std::unique_lock<rw_spin_lock> ul(rw);      // writer
+ *      */
+
+class rw_spin_lock {
+public:
+    rw_spin_lock() = default;
+    rw_spin_lock(const rw_spin_lock &) = delete;
+    rw_spin_lock &operator=(const rw_spin_lock &) = delete;
+
+    void lock() noexcept
+    {
+        backoff b;
+        while (true) {
+            auto s = state.load(std::memory_order_relaxed);
+
+            // No writer and no readers - take it (this also clears the waiting bit)
+            if ((s & ~writer_waiting) == 0) {
+                if (state.compare_exchange_weak(s, writer, std::memory_order_acquire, std::memory_order_relaxed))
+                    return;
+                continue;
+            }
+
+            // Stop any more readers coming in
+            if (!(s & writer_waiting))
+                state.fetch_or(writer_waiting, std::memory_order_relaxed);
+            b.pause();
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        auto s = state.load(std::memory_order_relaxed);
+        return (s & ~writer_waiting) == 0
+               && state.compare_exchange_strong(s, writer, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock() noexcept
+    {
+        state.fetch_and(~writer, std::memory_order_release);
+    }
+
+    void lock_shared() noexcept
+    {
+        backoff b;
+        while (true) {
+            auto s = state.load(std::memory_order_relaxed);
+            if (!(s & (writer | writer_waiting))) {
+                if (state.compare_exchange_weak(s, s + reader, std::memory_order_acquire, std::memory_order_relaxed))
+                    return;
+            }
+            else {
+                b.pause();
+            }
+        }
+    }
+
+    bool try_lock_shared() noexcept
+    {
+        auto s = state.load(std::memory_order_relaxed);
+        return !(s & (writer | writer_waiting))
+               && state.compare_exchange_strong(s, s + reader, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    void unlock_shared() noexcept
+    {
+        state.fetch_sub(reader, std::memory_order_release);
+    }
+
+private:
+    static constexpr std::uint32_t writer = 1;
+    static constexpr std::uint32_t writer_waiting = 2;
+    static constexpr std::uint32_t reader = 4;
+
+    std::atomic<std::uint32_t> state{0};
+};
+
+#endif //RW_SPIN_LOCK_H
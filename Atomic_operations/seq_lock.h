@@ -0,0 +1,99 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "backoff.h"
+
+/*
+ * Sequence Lock (seqlock)
+ *
+ * - With lock_cout or mut, a reader must write to the lock word
+ *      - The lock's cache line moves to every reader in turn
+ *      - Reads do not scale with the number of cores
+ *
+ * - A seqlock protects a small value with a sequence number
+ *      - The writer makes the number odd, writes the value, then makes it even again
+ *      - A reader reads the number, copies the value, then reads the number again
+ *      - If the number was odd, or has changed, the copy may be torn - try again
+ *
+ * - Readers never write to shared memory
+ *      - The cache lines stay shared between the readers' cores
+ * - The writer never waits for readers
+ *      - store() is wait-free, but there must only be one writer at a time
+ *
+ * - The value is copied in and out as relaxed atomic words
+ *      - So a reader racing with the writer is not a data race
+ *      - T must be trivially copyable
+ *      */
+
+template<typename T>
+class seq_lock {
+    static_assert(std::is_trivially_copyable_v<T>, "seq_lock<T> requires a trivially copyable T");
+
+public:
+    seq_lock() { store(T{}); }
+    explicit seq_lock(const T &value) { store(value); }
+
+    seq_lock(const seq_lock &) = delete;
+    seq_lock &operator=(const seq_lock &) = delete;
+
+    // Only one thread may call store() at a time
+    void store(const T &value) noexcept
+    {
+        word buffer[n_words] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        auto s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);        // Odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < n_words; ++i)
+            data[i].store(buffer[i], std::memory_order_relaxed);
+
+        seq.store(s + 2, std::memory_order_release);        // Even: value is consistent
+    }
+
+    T load() const noexcept
+    {
+        T value;
+        backoff b;
+        while (!try_load(value))
+            b.pause();
+        return value;
+    }
+
+    // One optimistic attempt - returns false if a write got in the way
+    bool try_load(T &value) const noexcept
+    {
+        auto s1 = seq.load(std::memory_order_acquire);
+        if (s1 & 1)
+            return false;
+
+        word buffer[n_words];
+        for (std::size_t i = 0; i < n_words; ++i)
+            buffer[i] = data[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) != s1)
+            return false;
+
+        std::memcpy(&value, buffer, sizeof(T));
+        return true;
+    }
+
+    // Number of completed writes
+    std::uint64_t version() const noexcept { return seq.load(std::memory_order_acquire) / 2; }
+
+private:
+    using word = std::uint64_t;
+    static constexpr std::size_t n_words = (sizeof(T) + sizeof(word) - 1) / sizeof(word);
+
+    std::atomic<std::uint64_t> seq{0};
+    std::atomic<word> data[n_words];
+};
+
+#endif //SEQ_LOCK_H
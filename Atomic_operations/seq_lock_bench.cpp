@@ -0,0 +1,126 @@
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include "seq_lock.h"
+#include "rw_spin_lock.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * seq_lock benchmark
+ *
+ * - Torture check first
+ *      - One writer stores snapshots whose fields are all equal
+ *      - Several readers load snapshots and check that the fields still agree
+ *      - Any mismatch is a torn read, and the program fails
+ *
+ * - Then read throughput with a writer running in the background
+ *      - seq_lock::load()
+ *      - rw_spin_lock and std::shared_mutex with a shared lock
+ *      */
+
+struct snapshot {
+    long long a, b, c, d, e, f;
+};
+
+bool snapshot_consistent(const snapshot &s)
+{
+    return s.a == s.b && s.b == s.c && s.c == s.d && s.d == s.e && s.e == s.f;
+}
+
+seq_lock<snapshot> seq;
+padded<rw_spin_lock> rw_lock;
+padded<std::shared_mutex> shared_mut;
+padded<snapshot> rw_snapshot;             // Only accessed under rw_lock
+padded<snapshot> mutex_snapshot;          // Only accessed under shared_mut
+
+// Returns the number of torn reads seen
+long long torture(int n_readers, int n_writes)
+{
+    std::atomic<bool> done{false};
+    std::atomic<long long> torn{0};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < n_readers; ++i) {
+        readers.emplace_back([&] {
+            long long last = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                auto s = seq.load();
+                if (!snapshot_consistent(s) || s.a < last)
+                    torn.fetch_add(1);
+                last = s.a;
+            }
+        });
+    }
+
+    for (long long i = 1; i <= n_writes; ++i)
+        seq.store(snapshot{i, i, i, i, i, i});
+
+    done = true;
+    for (auto &r : readers)
+        r.join();
+    return torn.load();
+}
+
+// Background writer for the throughput benchmarks
+std::atomic<bool> stop_writer{false};
+std::thread writer;
+
+void start_writer(int)
+{
+    stop_writer = false;
+    writer = std::thread([] {
+        using namespace std::literals;
+        for (long long i = 1; !stop_writer.load(std::memory_order_relaxed); ++i) {
+            snapshot s{i, i, i, i, i, i};
+            seq.store(s);
+            {
+                std::lock_guard<rw_spin_lock> lg(*rw_lock);
+                *rw_snapshot = s;
+            }
+            {
+                std::lock_guard<std::shared_mutex> lg(*shared_mut);
+                *mutex_snapshot = s;
+            }
+            std::this_thread::sleep_for(10us);
+        }
+    });
+}
+
+void stop_background_writer(bench::result &)
+{
+    stop_writer = true;
+    writer.join();
+}
+
+int main(int argc, char *argv[])
+{
+    int readers = std::max(2, bench::hardware_threads());
+    long long torn = torture(readers, 2'000'000);
+    std::cout << "torture: " << readers << " readers, 2000000 writes, torn reads: " << torn << std::endl;
+    if (torn != 0)
+        return 1;
+
+    const int threads = bench::hardware_threads();
+
+    bench::add("seq_lock/read", [](bench::context &) {
+        bench::do_not_optimize(seq.load());
+    }).threads_range(threads).setup(start_writer).teardown(stop_background_writer);
+
+    bench::add("rw_spin_lock/read", [](bench::context &) {
+        std::shared_lock<rw_spin_lock> sl(*rw_lock);
+        snapshot s = *rw_snapshot;
+        bench::do_not_optimize(s);
+    }).threads_range(threads).setup(start_writer).teardown(stop_background_writer);
+
+    bench::add("shared_mutex/read", [](bench::context &) {
+        std::shared_lock<std::shared_mutex> sl(*shared_mut);
+        snapshot s = *mutex_snapshot;
+        bench::do_not_optimize(s);
+    }).threads_range(threads).setup(start_writer).teardown(stop_background_writer);
+
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,299 @@
+#ifndef SKIP_LIST_H
+#define SKIP_LIST_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <optional>
+#include <utility>
+#include "epoch_reclamation.h"
+
+/*
+ * Lock-free Skip List
+ *
+ * - An ordered set of keys, like std::map, but with no locks
+ *      - e.g. pending tasks ordered by deadline, scanned in order
+ *
+ * - A sorted linked list, plus "express lanes"
+ *      - Every node is on level 0
+ *      - Half of them are also on level 1, a quarter on level 2, ...
+ *      - A search starts on the top level and drops down a level when it would overshoot
+ *      - O(log n) expected, with no rebalancing
+ *
+ * - Insertion
+ *      - Find the predecessor and successor on each level
+ *      - CAS the new node into level 0 - this is when it becomes part of the set
+ *      - Then CAS it into the higher levels, one by one
+ *
+ * - Deletion is in two steps
+ *      - Logical: mark the node's next pointers (lowest bit of the pointer), top level first
+ *        The thread whose CAS marks level 0 has deleted the key
+ *      - Physical: any search which meets a marked node unlinks it with a CAS on its predecessor
+ *      - A marked next pointer cannot be changed, so nothing can be linked after a deleted node
+ *
+ * - Memory reclamation
+ *      - A search holds pointers to a predecessor and successor on every level
+ *      - Hazard pointers would need two slots per level, so this uses epoch_reclamation
+ *      - A node is retired once it is deleted, unlinked from every level, and its insert has finished
+ *
+ * - Range iteration is weakly consistent
+ *      - It sees every key present for the whole scan, and may or may not see keys
+ *        inserted or erased during it
+ *
+ *          skip_list<long, task_id> pending;
+ *          pending.insert(deadline, id);
+ *          pending.for_each_in_range(now, now + window, [](long deadline, task_id id) { ... });
+ *      */
+
+template<typename K, typename V, typename Compare = std::less<K>>
+class skip_list {
+public:
+    static constexpr int max_level = 20;
+
+    skip_list() = default;
+    skip_list(const skip_list &) = delete;
+    skip_list &operator=(const skip_list &) = delete;
+
+    // Not thread-safe: no other thread may be using the list
+    ~skip_list()
+    {
+        auto *n = unmarked(head[0].load(std::memory_order_relaxed));
+        while (n) {
+            auto *next = unmarked(n->next[0].load(std::memory_order_relaxed));
+            delete n;
+            n = next;
+        }
+    }
+
+    // Returns false if the key is already present
+    bool insert(const K &key, const V &value)
+    {
+        epoch_reclamation::guard g;
+        node *preds[max_level];
+        node *succs[max_level];
+        int height = random_height();
+        node *n = nullptr;
+
+        while (true) {
+            if (find(key, preds, succs)) {
+                delete n;               // Never published
+                return false;
+            }
+            if (!n)
+                n = new (height) node(key, value, height);
+            for (int level = 0; level < height; ++level)
+                n->next[level].store(to_bits(succs[level]), std::memory_order_relaxed);
+
+            auto expected = to_bits(succs[0]);
+            if (slot(preds[0], 0).compare_exchange_strong(expected, to_bits(n), std::memory_order_release, std::memory_order_relaxed))
+                break;
+        }
+
+        // n is in the set - now add it to the express lanes
+        for (int level = 1; level < height; ++level) {
+            while (true) {
+                auto next = n->next[level].load(std::memory_order_acquire);
+                if (is_marked(next))
+                    goto done;              // Already being deleted
+                if (next != to_bits(succs[level])
+                    && !n->next[level].compare_exchange_strong(next, to_bits(succs[level]), std::memory_order_release, std::memory_order_relaxed))
+                    goto done;
+
+                auto expected = to_bits(succs[level]);
+                if (slot(preds[level], level).compare_exchange_strong(expected, to_bits(n), std::memory_order_release, std::memory_order_relaxed))
+                    break;
+
+                // The neighbours changed - search again, unless n has been removed from level 0
+                find(key, preds, succs);
+                if (succs[0] != n)
+                    goto done;
+            }
+        }
+
+    done:
+        // If n was deleted while we were linking it, we may have linked it again - unlink it
+        if (is_marked(n->next[0].load(std::memory_order_acquire)))
+            find(key, preds, succs);
+        release(n);
+        return true;
+    }
+
+    // Returns false if the key was not present
+    bool erase(const K &key)
+    {
+        epoch_reclamation::guard g;
+        node *preds[max_level];
+        node *succs[max_level];
+        if (!find(key, preds, succs))
+            return false;
+
+        node *n = succs[0];
+        for (int level = n->height - 1; level >= 1; --level) {
+            auto next = n->next[level].load(std::memory_order_relaxed);
+            while (!is_marked(next)
+                   && !n->next[level].compare_exchange_weak(next, next | mark_bit, std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+        }
+
+        auto next = n->next[0].load(std::memory_order_relaxed);
+        while (true) {
+            if (is_marked(next))
+                return false;           // Another thread deleted it first
+            if (n->next[0].compare_exchange_weak(next, next | mark_bit, std::memory_order_acq_rel, std::memory_order_relaxed))
+                break;
+        }
+
+        find(key, preds, succs);        // Unlink it from every level
+        release(n);
+        return true;
+    }
+
+    std::optional<V> find(const K &key) const
+    {
+        epoch_reclamation::guard g;
+        node *n = lower_bound(key);
+        if (n && !less(key, n->key))
+            return n->value;
+        return std::nullopt;
+    }
+
+    bool contains(const K &key) const { return find(key).has_value(); }
+
+    // Call f(key, value) for every key in [from, to), in order
+    template<typename F>
+    void for_each_in_range(const K &from, const K &to, F &&f) const
+    {
+        epoch_reclamation::guard g;
+        for (node *n = lower_bound(from); n && less(n->key, to);) {
+            auto next = n->next[0].load(std::memory_order_acquire);
+            if (!is_marked(next))
+                f(n->key, n->value);
+            n = unmarked(next);
+        }
+    }
+
+    bool empty() const
+    {
+        epoch_reclamation::guard g;
+        return lower_bound_node(nullptr) == nullptr;
+    }
+
+private:
+    static constexpr std::uintptr_t mark_bit = 1;
+
+    struct node {
+        node(const K &key, const V &value, int height) : key(key), value(value), height(height)
+        {
+            for (int level = 0; level < height; ++level)
+                new (&next[level]) std::atomic<std::uintptr_t>(0);
+        }
+
+        // Nodes are allocated with room for exactly height next pointers
+        static void *operator new(std::size_t size, int height)
+        {
+            return ::operator new(size + (height - 1) * sizeof(std::atomic<std::uintptr_t>));
+        }
+        static void operator delete(void *p) { ::operator delete(p); }
+        static void operator delete(void *p, int) { ::operator delete(p); }
+
+        const K key;
+        const V value;
+        const int height;
+        std::atomic<int> refs{2};                       // The insert and the erase
+        std::atomic<std::uintptr_t> next[1];            // Really next[height]
+    };
+
+    static bool is_marked(std::uintptr_t bits) noexcept { return bits & mark_bit; }
+    static node *unmarked(std::uintptr_t bits) noexcept { return reinterpret_cast<node *>(bits & ~mark_bit); }
+    static std::uintptr_t to_bits(node *n) noexcept { return reinterpret_cast<std::uintptr_t>(n); }
+
+    bool less(const K &a, const K &b) const { return compare(a, b); }
+
+    // The next pointer on this level of pred, or of the head if pred is null
+    std::atomic<std::uintptr_t> &slot(node *pred, int level) noexcept
+    {
+        return pred ? pred->next[level] : head[level];
+    }
+
+    const std::atomic<std::uintptr_t> &slot(const node *pred, int level) const noexcept
+    {
+        return pred ? pred->next[level] : head[level];
+    }
+
+    static int random_height() noexcept
+    {
+        thread_local std::uint64_t state = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<std::uintptr_t>(&state);
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        // Level i with probability 1/2^(i+1)
+        int height = 1 + std::countr_one(state);
+        return height < max_level ? height : max_level;
+    }
+
+    // Fill preds and succs with the neighbours of key on each level, unlinking marked nodes on the way
+    // Returns true if succs[0] holds key
+    bool find(const K &key, node **preds, node **succs)
+    {
+    retry:
+        node *pred = nullptr;
+        for (int level = max_level - 1; level >= 0; --level) {
+            node *curr = unmarked(slot(pred, level).load(std::memory_order_acquire));
+            while (curr) {
+                auto next = curr->next[level].load(std::memory_order_acquire);
+                if (is_marked(next)) {
+                    // curr is deleted - unlink it on this level
+                    auto expected = to_bits(curr);
+                    if (!slot(pred, level).compare_exchange_strong(expected, next & ~mark_bit, std::memory_order_acq_rel, std::memory_order_acquire))
+                        goto retry;
+                    curr = unmarked(next);
+                    continue;
+                }
+                if (!less(curr->key, key))
+                    break;
+                pred = curr;
+                curr = unmarked(next);
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return succs[0] && !less(key, succs[0]->key);
+    }
+
+    // First node which is not deleted and whose key is not less than key - does not unlink anything
+    node *lower_bound(const K &key) const { return lower_bound_node(&key); }
+
+    node *lower_bound_node(const K *key) const
+    {
+        const node *pred = nullptr;
+        node *curr = nullptr;
+        for (int level = max_level - 1; level >= 0; --level) {
+            curr = unmarked(slot(pred, level).load(std::memory_order_acquire));
+            while (curr) {
+                auto next = curr->next[level].load(std::memory_order_acquire);
+                if (is_marked(next)) {
+                    curr = unmarked(next);
+                    continue;
+                }
+                if (!key || !less(curr->key, *key))
+                    break;
+                pred = curr;
+                curr = unmarked(next);
+            }
+        }
+        return curr;
+    }
+
+    void release(node *n)
+    {
+        if (n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            epoch_reclamation::retire(n);
+    }
+
+    std::atomic<std::uintptr_t> head[max_level] = {};
+    [[no_unique_address]] Compare compare;
+};
+
+#endif //SKIP_LIST_H
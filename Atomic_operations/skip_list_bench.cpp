@@ -0,0 +1,158 @@
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include "skip_list.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * skip_list benchmark
+ *
+ * - Check first
+ *      - Each thread inserts and erases its own keys, while readers scan the whole list
+ *      - Every scan must be in order, and the final contents must be exactly the keys left behind
+ *
+ * - Then throughput, with 64K keys of which half are present
+ *      - lookup: 90% find, 5% insert, 5% erase
+ *      - scan: 90% find, 10% range scans of about 16 keys
+ *      - skip_list vs std::map under a std::mutex
+ *      */
+
+constexpr long key_range = 65536;
+
+// Returns the number of errors seen
+long check(int n_writers, int n_readers)
+{
+    skip_list<long, long> list;
+    constexpr long keys_per_writer = 20'000;
+    std::atomic<bool> done{false};
+    std::atomic<long> errors{0};
+
+    std::vector<std::thread> readers;
+    for (int r = 0; r < n_readers; ++r) {
+        readers.emplace_back([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                long last = -1;
+                list.for_each_in_range(0, n_writers * keys_per_writer, [&](long key, long value) {
+                    if (key <= last || value != key * 3)
+                        errors.fetch_add(1);
+                    last = key;
+                });
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < n_writers; ++w) {
+        writers.emplace_back([&, w] {
+            // Keys interleaved between writers: w, w + n_writers, ...
+            for (long i = 0; i < keys_per_writer; ++i)
+                list.insert(w + i * n_writers, (w + i * n_writers) * 3);
+            // Leave the multiples of 4
+            for (long i = 0; i < keys_per_writer; ++i) {
+                long key = w + i * n_writers;
+                if (key % 4 != 0 && !list.erase(key))
+                    errors.fetch_add(1);
+            }
+        });
+    }
+    for (auto &w : writers)
+        w.join();
+    done = true;
+    for (auto &r : readers)
+        r.join();
+
+    long expected = 0;
+    list.for_each_in_range(0, n_writers * keys_per_writer, [&](long key, long) {
+        if (key != expected)
+            errors.fetch_add(1);
+        expected = key + 4;
+    });
+    if (expected != n_writers * keys_per_writer)
+        errors.fetch_add(1);
+    return errors.load();
+}
+
+skip_list<long, long> list;
+
+padded<std::mutex> mut;
+std::map<long, long> locked_map;
+
+void populate()
+{
+    for (long k = 0; k < key_range; k += 2) {
+        list.insert(k, k);
+        locked_map.emplace(k, k);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    long errors = check(4, 2);
+    std::printf("check: %ld errors\n", errors);
+    if (errors)
+        return 1;
+
+    populate();
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("skip_list/lookup", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        auto op = rng() % 20;
+        if (op == 0)
+            list.insert(key, key);
+        else if (op == 1)
+            list.erase(key);
+        else
+            bench::do_not_optimize(list.find(key));
+    }).threads(thread_counts);
+
+    bench::add("mutex_map/lookup", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        auto op = rng() % 20;
+        std::lock_guard<std::mutex> lg(*mut);
+        if (op == 0)
+            locked_map.emplace(key, key);
+        else if (op == 1)
+            locked_map.erase(key);
+        else
+            bench::do_not_optimize(locked_map.find(key));
+    }).threads(thread_counts);
+
+    bench::add("skip_list/scan", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        if (rng() % 10 == 0) {
+            long sum = 0;
+            list.for_each_in_range(key, key + 32, [&](long, long value) { sum += value; });
+            bench::do_not_optimize(sum);
+        }
+        else {
+            bench::do_not_optimize(list.find(key));
+        }
+    }).threads(thread_counts);
+
+    bench::add("mutex_map/scan", [](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        long key = long(rng() % key_range);
+        bool scan = rng() % 10 == 0;
+        std::lock_guard<std::mutex> lg(*mut);
+        if (scan) {
+            long sum = 0;
+            for (auto it = locked_map.lower_bound(key); it != locked_map.end() && it->first < key + 32; ++it)
+                sum += it->second;
+            bench::do_not_optimize(sum);
+        }
+        else {
+            bench::do_not_optimize(locked_map.find(key));
+        }
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
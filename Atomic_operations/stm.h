@@ -0,0 +1,299 @@
+#ifndef STM_H
+#define STM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "backoff.h"
+#include "padded.h"
+
+/*
+ * Software Transactional Memory (STM)
+ *
+ * - Update several shared variables as one atomic transaction
+ *      - No locks for the caller to order, so no deadlock
+ *      - The transaction runs optimistically, and is retried if another one conflicts
+ *
+ * - This is a word-based "TL2" (Transactional Locking II) design
+ *      - A global version clock
+ *      - A table of versioned locks ("stripes") - each word of memory hashes to one of them
+ *
+ * - Reading a tvar
+ *      - Check its stripe is unlocked and no newer than the clock value at the start
+ *      - Otherwise another transaction has committed since we started - abort and retry
+ *      - Remember the stripe in the read set
+ *
+ * - Writing a tvar
+ *      - Only goes into the write set - memory is not changed until commit
+ *
+ * - Commit
+ *      - Lock the stripes in the write set (abort if any is already locked)
+ *      - Increment the clock to get the write version
+ *      - Check every stripe in the read set is still no newer than our start
+ *      - Write the values, then unlock the stripes with the write version
+ *      - Read-only transactions have nothing to do
+ *
+ * - The function passed to atomically() may run several times
+ *      - It must not have side effects apart from tx::write()
+ *      - A tvar holds a trivially copyable value of at most 8 bytes
+ *
+ *          tvar<long> from{100}, to{0};
+ *          atomically([&](tx &t) {
+ *              t.write(from, t.read(from) - 10);
+ *              t.write(to, t.read(to) + 10);
+ *          });
+ *      */
+
+template<typename T>
+class tvar {
+    static_assert(std::is_trivially_copyable_v<T>, "tvar<T> requires a trivially copyable T");
+    static_assert(sizeof(T) <= sizeof(std::uint64_t), "tvar<T> holds at most one 64-bit word");
+
+public:
+    tvar() : tvar(T{}) {}
+
+    explicit tvar(const T &value)
+    {
+        std::uint64_t w = 0;
+        std::memcpy(&w, &value, sizeof(T));
+        word.store(w, std::memory_order_relaxed);
+    }
+
+    tvar(const tvar &) = delete;
+    tvar &operator=(const tvar &) = delete;
+
+private:
+    friend class tx;
+    std::atomic<std::uint64_t> word;
+};
+
+class tx {
+public:
+    tx(const tx &) = delete;
+    tx &operator=(const tx &) = delete;
+
+    template<typename T>
+    T read(const tvar<T> &v)
+    {
+        auto w = read_word(v.word);
+        T value;
+        std::memcpy(&value, &w, sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    void write(tvar<T> &v, const T &value)
+    {
+        std::uint64_t w = 0;
+        std::memcpy(&w, &value, sizeof(T));
+        write_word(v.word, w);
+    }
+
+private:
+    template<typename F>
+    friend std::invoke_result_t<F &, tx &> atomically(F &&f);
+
+    using word = std::uint64_t;
+
+    // Thrown by read() and commit() to restart the transaction
+    struct abort_exception {};
+
+    struct write_entry {
+        std::atomic<word> *address;
+        word value;
+    };
+
+    struct lock_entry {
+        std::atomic<word> *lock;
+        word old_version;
+    };
+
+    // Stripe lock word: (version << 1) | locked
+    static constexpr std::size_t n_stripes = 1 << 16;
+
+    struct domain {
+        padded<std::atomic<word>> clock{0};
+        std::atomic<word> stripes[n_stripes] = {};
+    };
+
+    static domain &global()
+    {
+        static domain d;
+        return d;
+    }
+
+    static std::atomic<word> &stripe(const void *address) noexcept
+    {
+        auto a = reinterpret_cast<std::uintptr_t>(address);
+        return global().stripes[(a >> 3) & (n_stripes - 1)];
+    }
+
+    static tx &local()
+    {
+        thread_local tx t;
+        return t;
+    }
+
+    tx() = default;
+
+    [[noreturn]] static void abort() { throw abort_exception{}; }
+
+    void begin() noexcept
+    {
+        active = true;
+        read_version = global().clock->load(std::memory_order_acquire);
+    }
+
+    word read_word(const std::atomic<word> &address)
+    {
+        // Read our own writes
+        for (auto it = write_set.rbegin(); it != write_set.rend(); ++it) {
+            if (it->address == &address)
+                return it->value;
+        }
+
+        auto &lock = stripe(&address);
+        auto v1 = lock.load(std::memory_order_acquire);
+        auto value = address.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto v2 = lock.load(std::memory_order_relaxed);
+
+        // Locked, changed while we read it, or changed since we started
+        if ((v1 & 1) || v1 != v2 || (v1 >> 1) > read_version)
+            abort();
+
+        read_set.push_back(&lock);
+        return value;
+    }
+
+    void write_word(std::atomic<word> &address, word value)
+    {
+        for (auto &e : write_set) {
+            if (e.address == &address) {
+                e.value = value;
+                return;
+            }
+        }
+        write_set.push_back({&address, value});
+    }
+
+    const lock_entry *find_locked(const std::atomic<word> *lock) const noexcept
+    {
+        for (auto &l : locked) {
+            if (l.lock == lock)
+                return &l;
+        }
+        return nullptr;
+    }
+
+    void unlock_all() noexcept
+    {
+        for (auto &l : locked)
+            l.lock->store(l.old_version, std::memory_order_release);
+        locked.clear();
+    }
+
+    void commit()
+    {
+        if (write_set.empty()) {
+            finish();
+            return;
+        }
+
+        for (auto &e : write_set) {
+            auto &lock = stripe(e.address);
+            if (find_locked(&lock))
+                continue;
+            auto v = lock.load(std::memory_order_relaxed);
+            if ((v & 1) || !lock.compare_exchange_strong(v, v | 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                unlock_all();
+                abort();
+            }
+            locked.push_back({&lock, v});
+        }
+
+        auto write_version = global().clock->fetch_add(1, std::memory_order_acq_rel) + 1;
+
+        // If nobody else committed since we started, the read set must still be valid
+        if (write_version != read_version + 1) {
+            for (auto *lock : read_set) {
+                auto v = lock->load(std::memory_order_acquire);
+                if (v & 1) {
+                    auto *l = find_locked(lock);
+                    if (!l) {
+                        unlock_all();
+                        abort();
+                    }
+                    v = l->old_version;
+                }
+                if ((v >> 1) > read_version) {
+                    unlock_all();
+                    abort();
+                }
+            }
+        }
+
+        // Readers must see our stripes locked before any of the new values (pairs with read_word's fence)
+        std::atomic_thread_fence(std::memory_order_release);
+        for (auto &e : write_set)
+            e.address->store(e.value, std::memory_order_relaxed);
+        for (auto &l : locked)
+            l.lock->store(write_version << 1, std::memory_order_release);
+        locked.clear();
+        finish();
+    }
+
+    void finish() noexcept
+    {
+        read_set.clear();
+        write_set.clear();
+        active = false;
+    }
+
+    bool active = false;
+    word read_version = 0;
+    std::vector<const std::atomic<word> *> read_set;
+    std::vector<write_entry> write_set;
+    std::vector<lock_entry> locked;
+};
+
+// Run f(tx &) as one transaction and return its result
+// A nested call becomes part of the outer transaction
+// If f throws, its writes are discarded and the exception is passed on
+template<typename F>
+std::invoke_result_t<F &, tx &> atomically(F &&f)
+{
+    tx &t = tx::local();
+    if (t.active)
+        return f(t);
+
+    backoff b;
+    while (true) {
+        t.begin();
+        try {
+            if constexpr (std::is_void_v<std::invoke_result_t<F &, tx &>>) {
+                f(t);
+                t.commit();
+                return;
+            }
+            else {
+                auto result = f(t);
+                t.commit();
+                return result;
+            }
+        }
+        catch (const tx::abort_exception &) {
+            t.finish();
+        }
+        catch (...) {
+            t.finish();
+            throw;
+        }
+        b.pause();
+    }
+}
+
+#endif //STM_H
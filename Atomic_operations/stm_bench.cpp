@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+#include "stm.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Bank transfers
+ *
+ * - Move money between two randomly chosen accounts
+ *      - Both balances must change together
+ * - With 1024 accounts (little contention) and 8 accounts (a lot)
+ *
+ * - STM: both updates in one atomically() transaction
+ * - Global mutex: one std::mutex for every account
+ * - Fine-grained locks: one std::mutex per account, locked in index order to avoid deadlock
+ *
+ * - After the benchmarks, the total in each bank must not have changed
+ *      */
+
+constexpr long initial_balance = 1000;
+
+struct stm_bank {
+    explicit stm_bank(int n) : accounts(n)
+    {
+        for (auto &a : accounts)
+            a = std::make_unique<tvar<long>>(initial_balance);
+    }
+
+    void transfer(int from, int to, long amount)
+    {
+        atomically([&](tx &t) {
+            t.write(*accounts[from], t.read(*accounts[from]) - amount);
+            t.write(*accounts[to], t.read(*accounts[to]) + amount);
+        });
+    }
+
+    long total()
+    {
+        return atomically([&](tx &t) {
+            long sum = 0;
+            for (auto &a : accounts)
+                sum += t.read(*a);
+            return sum;
+        });
+    }
+
+    std::vector<std::unique_ptr<tvar<long>>> accounts;
+};
+
+struct global_mutex_bank {
+    explicit global_mutex_bank(int n) : accounts(n, initial_balance) {}
+
+    void transfer(int from, int to, long amount)
+    {
+        std::lock_guard<std::mutex> lg(mut);
+        accounts[from] -= amount;
+        accounts[to] += amount;
+    }
+
+    long total()
+    {
+        std::lock_guard<std::mutex> lg(mut);
+        long sum = 0;
+        for (auto a : accounts)
+            sum += a;
+        return sum;
+    }
+
+    alignas(cache_line_size) std::mutex mut;
+    std::vector<long> accounts;
+};
+
+struct fine_grained_bank {
+    struct account {
+        std::mutex mut;
+        long balance = initial_balance;
+    };
+
+    explicit fine_grained_bank(int n) : accounts(n) {}
+
+    void transfer(int from, int to, long amount)
+    {
+        auto &first = *accounts[std::min(from, to)];
+        auto &second = *accounts[std::max(from, to)];
+        std::lock_guard<std::mutex> lg1(first.mut);
+        std::lock_guard<std::mutex> lg2(second.mut);
+        accounts[from]->balance -= amount;
+        accounts[to]->balance += amount;
+    }
+
+    long total()
+    {
+        long sum = 0;
+        for (auto &a : accounts) {
+            std::lock_guard<std::mutex> lg(a->mut);
+            sum += a->balance;
+        }
+        return sum;
+    }
+
+    std::vector<padded<account>> accounts;
+};
+
+template<typename Bank>
+void add_transfer_bench(const std::string &name, Bank &bank, int n_accounts, const std::vector<int> &thread_counts)
+{
+    bench::add(name + "/" + std::to_string(n_accounts) + "_accounts", [&bank, n_accounts](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        int from = int(rng() % n_accounts);
+        int to = int(rng() % (n_accounts - 1));
+        if (to >= from)
+            ++to;
+        bank.transfer(from, to, long(rng() % 10));
+    }).threads(thread_counts);
+}
+
+template<typename Bank>
+bool check(const char *name, Bank &bank, int n_accounts)
+{
+    long expected = initial_balance * n_accounts;
+    long total = bank.total();
+    if (total != expected)
+        std::printf("%s/%d_accounts: total %ld, expected %ld\n", name, n_accounts, total, expected);
+    return total == expected;
+}
+
+stm_bank stm_small(8), stm_large(1024);
+global_mutex_bank global_small(8), global_large(1024);
+fine_grained_bank fine_small(8), fine_large(1024);
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    add_transfer_bench("stm", stm_large, 1024, thread_counts);
+    add_transfer_bench("global_mutex", global_large, 1024, thread_counts);
+    add_transfer_bench("fine_grained", fine_large, 1024, thread_counts);
+    add_transfer_bench("stm", stm_small, 8, thread_counts);
+    add_transfer_bench("global_mutex", global_small, 8, thread_counts);
+    add_transfer_bench("fine_grained", fine_small, 8, thread_counts);
+
+    int result = bench::run(argc, argv);
+
+    bool ok = check("stm", stm_large, 1024);
+    ok = check("stm", stm_small, 8) && ok;
+    ok = check("global_mutex", global_large, 1024) && ok;
+    ok = check("global_mutex", global_small, 8) && ok;
+    ok = check("fine_grained", fine_large, 1024) && ok;
+    ok = check("fine_grained", fine_small, 8) && ok;
+    return ok ? result : 1;
+}
@@ -0,0 +1,216 @@
+#ifndef TAGGED_PTR_H
+#define TAGGED_PTR_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Tagged Pointers
+ *
+ * - The ABA problem
+ *      - Thread 1 reads top == A and top->next == B, then is interrupted
+ *      - Thread 2 pops A, pops B, pushes A back
+ *      - Thread 1's compare_exchange(A, B) succeeds, because top is A again
+ *      - But B is no longer on the list
+ *
+ * - Fix: store a version number ("tag") next to the pointer
+ *      - Every successful CAS increments the tag
+ *      - Thread 1's CAS now fails, because the tag has changed even though the pointer has not
+ *      - Nodes can be reused straight away - no hazard pointers or epochs needed
+ *      - But the memory must never be given back to the system, because
+ *        a slow thread may still read top->next
+ *
+ * - tagged_ptr<T>
+ *      - On x86-64 and AArch64, user space pointers only use the low 48 bits
+ *      - The tag goes in the top 16 bits, so std::atomic<tagged_ptr<T>> is one 8-byte word
+ *      - The tag wraps after 65536 updates
+ *
+ * - counted_ptr<T> and atomic_counted_ptr<T>
+ *      - The pointer and a 64-bit tag side by side, 16 bytes in total
+ *      - Needs a 16-byte compare-exchange: cmpxchg16b on x86-64 (compile with -mcx16)
+ *      - Otherwise falls back to std::atomic<counted_ptr<T>>, which may use a lock (link with libatomic)
+ *
+ * - Both have get(), tag() and next_version()
+ *          std::atomic<tagged_ptr<node>> head;
+ *          auto top = head.load();
+ *          head.compare_exchange_weak(top, top.next_version(top->next));
+ *
+ * - tagged_stack<Node> is an ABA-safe intrusive stack built this way
+ *      - For free lists of objects which are reused but never freed
+ *      */
+
+template<typename T>
+class tagged_ptr {
+public:
+    using tag_type = std::uint16_t;
+
+    tagged_ptr() noexcept = default;
+
+    tagged_ptr(T *p, tag_type tag = 0) noexcept
+        : bits(reinterpret_cast<std::uintptr_t>(p) | (std::uintptr_t(tag) << tag_shift)) {}
+
+    T *get() const noexcept { return reinterpret_cast<T *>(bits & pointer_mask); }
+    tag_type tag() const noexcept { return tag_type(bits >> tag_shift); }
+
+    T *operator->() const noexcept { return get(); }
+    explicit operator bool() const noexcept { return get() != nullptr; }
+
+    // Point to p, with the next tag - the desired value for a CAS
+    tagged_ptr next_version(T *p) const noexcept { return tagged_ptr(p, tag_type(tag() + 1)); }
+
+    friend bool operator==(tagged_ptr, tagged_ptr) = default;
+
+private:
+    static_assert(sizeof(std::uintptr_t) == 8, "tagged_ptr needs 64-bit pointers");
+    static constexpr int tag_shift = 48;
+    static constexpr std::uintptr_t pointer_mask = (std::uintptr_t(1) << tag_shift) - 1;
+
+    std::uintptr_t bits = 0;
+};
+
+template<typename T>
+class alignas(2 * sizeof(void *)) counted_ptr {
+public:
+    using tag_type = std::uint64_t;
+
+    counted_ptr() noexcept = default;
+    counted_ptr(T *p, tag_type tag = 0) noexcept : ptr(p), count(tag) {}
+
+    T *get() const noexcept { return ptr; }
+    tag_type tag() const noexcept { return count; }
+
+    T *operator->() const noexcept { return ptr; }
+    explicit operator bool() const noexcept { return ptr != nullptr; }
+
+    counted_ptr next_version(T *p) const noexcept { return counted_ptr(p, count + 1); }
+
+    friend bool operator==(const counted_ptr &, const counted_ptr &) = default;
+
+private:
+    T *ptr = nullptr;
+    tag_type count = 0;
+};
+
+// std::atomic<counted_ptr<T>>, but with an inline cmpxchg16b when the compiler has it
+template<typename T>
+class atomic_counted_ptr {
+public:
+    using value_type = counted_ptr<T>;
+
+    atomic_counted_ptr() noexcept : atomic_counted_ptr(value_type{}) {}
+
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+    explicit atomic_counted_ptr(value_type v) noexcept : value(to_bits(v)) {}
+
+    atomic_counted_ptr(const atomic_counted_ptr &) = delete;
+    atomic_counted_ptr &operator=(const atomic_counted_ptr &) = delete;
+
+    // The __sync builtins are full barriers, so the memory order arguments are not needed
+
+    // There is no 16-byte atomic load, so compare-exchange with 0 and take the old value
+    value_type load(std::memory_order = std::memory_order_seq_cst) const noexcept
+    {
+        return from_bits(__sync_val_compare_and_swap(&value, bits_type(0), bits_type(0)));
+    }
+
+    void store(value_type v, std::memory_order = std::memory_order_seq_cst) noexcept
+    {
+        auto expected = load();
+        while (!compare_exchange_strong(expected, v)) {}
+    }
+
+    bool compare_exchange_strong(value_type &expected, value_type desired,
+                                 std::memory_order = std::memory_order_seq_cst,
+                                 std::memory_order = std::memory_order_seq_cst) noexcept
+    {
+        auto old = to_bits(expected);
+        auto seen = __sync_val_compare_and_swap(&value, old, to_bits(desired));
+        if (seen == old)
+            return true;
+        expected = from_bits(seen);
+        return false;
+    }
+
+    static constexpr bool is_always_lock_free = true;
+    bool is_lock_free() const noexcept { return true; }
+
+private:
+    using bits_type = unsigned __int128;
+
+    static bits_type to_bits(value_type v) noexcept { return std::bit_cast<bits_type>(v); }
+    static value_type from_bits(bits_type b) noexcept { return std::bit_cast<value_type>(b); }
+
+    alignas(16) mutable bits_type value;
+#else
+    explicit atomic_counted_ptr(value_type v) noexcept : value(v) {}
+
+    atomic_counted_ptr(const atomic_counted_ptr &) = delete;
+    atomic_counted_ptr &operator=(const atomic_counted_ptr &) = delete;
+
+    value_type load(std::memory_order order = std::memory_order_seq_cst) const noexcept
+    {
+        return value.load(order);
+    }
+
+    void store(value_type v, std::memory_order order = std::memory_order_seq_cst) noexcept
+    {
+        value.store(v, order);
+    }
+
+    bool compare_exchange_strong(value_type &expected, value_type desired,
+                                 std::memory_order success = std::memory_order_seq_cst,
+                                 std::memory_order failure = std::memory_order_seq_cst) noexcept
+    {
+        return value.compare_exchange_strong(expected, desired, success, failure);
+    }
+
+    static constexpr bool is_always_lock_free = std::atomic<value_type>::is_always_lock_free;
+    bool is_lock_free() const noexcept { return value.is_lock_free(); }
+
+private:
+    std::atomic<value_type> value;
+#endif
+
+public:
+    bool compare_exchange_weak(value_type &expected, value_type desired,
+                               std::memory_order success = std::memory_order_seq_cst,
+                               std::memory_order failure = std::memory_order_seq_cst) noexcept
+    {
+        return compare_exchange_strong(expected, desired, success, failure);
+    }
+};
+
+// Lock-free intrusive stack - Node needs a std::atomic<Node *> next member
+// Nodes may be pushed again straight after pop(), but must not be freed while the stack is in use
+template<typename Node, typename Head = std::atomic<tagged_ptr<Node>>>
+class tagged_stack {
+public:
+    void push(Node *n) noexcept
+    {
+        auto top = head.load(std::memory_order_relaxed);
+        do {
+            n->next.store(top.get(), std::memory_order_relaxed);
+        } while (!head.compare_exchange_weak(top, top.next_version(n), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    Node *pop() noexcept
+    {
+        auto top = head.load(std::memory_order_acquire);
+        while (top) {
+            // top may already have been popped by another thread - the tag makes the CAS fail if so
+            auto next = top->next.load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(top, top.next_version(next), std::memory_order_acquire, std::memory_order_acquire))
+                return top.get();
+        }
+        return nullptr;
+    }
+
+    bool is_lock_free() const noexcept { return head.is_lock_free(); }
+
+private:
+    Head head;
+};
+
+#endif //TAGGED_PTR_H
@@ -0,0 +1,109 @@
+#include <cstdio>
+#include <mutex>
+#include <vector>
+#include "tagged_ptr.h"
+#include "treiber_stack.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * ABA-safe free lists
+ *
+ * - A fixed pool of task objects, linked through the objects themselves
+ * - Each operation takes an object from the free list and puts it back
+ * - Head is std::atomic<tagged_ptr<>> (8 bytes), atomic_counted_ptr<> (16 bytes),
+ *   a Treiber stack with hazard pointers, or a std::vector under a std::mutex
+ *
+ * - After the benchmarks, every free list must still hold the whole pool
+ *      - A lost or duplicated object means an ABA bug
+ *      */
+
+struct task_object {
+    std::atomic<task_object *> next{nullptr};
+    int id = 0;
+    char payload[52];
+};
+
+constexpr int pool_size = 1024;
+
+template<typename List>
+void fill(List &list, std::vector<task_object> &pool)
+{
+    for (auto &t : pool)
+        list.push(&t);
+}
+
+template<typename List>
+bool check(const char *name, List &list)
+{
+    int count = 0;
+    while (list.pop())
+        ++count;
+    if (count != pool_size)
+        std::printf("%s: %d objects in the free list, expected %d\n", name, count, pool_size);
+    return count == pool_size;
+}
+
+std::vector<task_object> tagged_pool(pool_size), counted_pool(pool_size), locked_pool(pool_size);
+
+tagged_stack<task_object> tagged_list;
+tagged_stack<task_object, atomic_counted_ptr<task_object>> counted_list;
+treiber_stack<task_object *> hazard_list;
+
+padded<std::mutex> mut;
+std::vector<task_object *> locked_list;
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    std::printf("tagged_ptr head lock-free: %d, counted_ptr head lock-free: %d\n",
+                tagged_list.is_lock_free(), counted_list.is_lock_free());
+
+    fill(tagged_list, tagged_pool);
+    fill(counted_list, counted_pool);
+    fill(hazard_list, locked_pool);
+    for (auto &t : locked_pool)
+        locked_list.push_back(&t);
+
+    bench::add("tagged_ptr/pop_push", [](bench::context &) {
+        if (auto t = tagged_list.pop()) {
+            bench::do_not_optimize(t);
+            tagged_list.push(t);
+        }
+    }).threads(thread_counts);
+
+    bench::add("counted_ptr/pop_push", [](bench::context &) {
+        if (auto t = counted_list.pop()) {
+            bench::do_not_optimize(t);
+            counted_list.push(t);
+        }
+    }).threads(thread_counts);
+
+    bench::add("hazard_pointers/pop_push", [](bench::context &) {
+        if (auto t = hazard_list.pop()) {
+            bench::do_not_optimize(*t);
+            hazard_list.push(*t);
+        }
+    }).threads(thread_counts);
+
+    bench::add("mutex_vector/pop_push", [](bench::context &) {
+        task_object *t = nullptr;
+        {
+            std::lock_guard<std::mutex> lg(*mut);
+            if (locked_list.empty())
+                return;
+            t = locked_list.back();
+            locked_list.pop_back();
+        }
+        bench::do_not_optimize(t);
+        std::lock_guard<std::mutex> lg(*mut);
+        locked_list.push_back(t);
+    }).threads(thread_counts);
+
+    int result = bench::run(argc, argv);
+
+    bool ok = check("tagged_ptr", tagged_list);
+    ok = check("counted_ptr", counted_list) && ok;
+    return ok ? result : 1;
+}
@@ -0,0 +1,89 @@
+#ifndef TREIBER_STACK_H
+#define TREIBER_STACK_H
+
+#include <atomic>
+#include <optional>
+#include <utility>
+#include "hazard_pointers.h"
+
+/*
+ * Treiber Stack
+ *
+ * - The simplest lock-free data structure
+ *      - A singly linked list, with an atomic pointer to the top node
+ *
+ * - push()
+ *      - Make a new node whose next is the current top
+ *      - compare_exchange_weak() the top from that value to the new node
+ *      - If another thread changed the top in between, the CAS fails - try again
+ *
+ * - pop()
+ *      - Read the top node, then compare_exchange_weak() the top to its next
+ *      - Reading top->next is only safe if the node cannot be freed meanwhile
+ *      - So the top node is protected by a hazard pointer, and retired instead of deleted
+ *      - This also prevents ABA: a protected node cannot be reused at the same address
+ *
+ * - Usable as a free list, e.g. of task objects
+ *          treiber_stack<task *> free_list;
+ *          free_list.push(t);
+ *          if (auto t = free_list.pop()) ...
+ *
+ * - Reclaimer is the memory reclamation policy
+ *      - hazard_pointers (default): bounded memory
+ *      - epoch_reclamation: faster pop(), unbounded memory
+ *      */
+
+template<typename T, typename Reclaimer = hazard_pointers>
+class treiber_stack {
+public:
+    treiber_stack() = default;
+    treiber_stack(const treiber_stack &) = delete;
+    treiber_stack &operator=(const treiber_stack &) = delete;
+
+    // Not thread-safe: no other thread may be using the stack
+    ~treiber_stack()
+    {
+        node *n = head.load(std::memory_order_relaxed);
+        while (n) {
+            node *next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    void push(T value)
+    {
+        node *n = new node{std::move(value), head.load(std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    std::optional<T> pop()
+    {
+        typename Reclaimer::guard g;
+        while (true) {
+            node *top = g.protect(head);
+            if (!top)
+                return std::nullopt;
+
+            node *next = top->next;
+            if (head.compare_exchange_weak(top, next, std::memory_order_acquire, std::memory_order_relaxed)) {
+                std::optional<T> value(std::move(top->value));
+                g.reset();
+                Reclaimer::retire(top);
+                return value;
+            }
+        }
+    }
+
+    bool empty() const noexcept { return head.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    struct node {
+        T value;
+        node *next;
+    };
+
+    std::atomic<node *> head{nullptr};
+};
+
+#endif //TREIBER_STACK_H
@@ -0,0 +1,60 @@
+#include <mutex>
+#include <vector>
+#include "treiber_stack.h"
+#include "epoch_reclamation.h"
+#include "padded.h"
+#include "benchmark.h"
+
+/*
+ * Treiber stack vs std::vector under a std::mutex
+ *
+ * - Each operation is a push followed by a pop, like taking an object
+ *   from a free list and putting it back
+ * - 1 to 64 threads
+ * - The Treiber stack with hazard pointers and with epoch-based reclamation
+ *      */
+
+struct task_object {
+    int id;
+    char payload[56];
+};
+
+treiber_stack<task_object *> free_list;
+treiber_stack<task_object *, epoch_reclamation> free_list_ebr;
+
+padded<std::mutex> mut;
+std::vector<task_object *> locked_free_list;
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> thread_counts{1, 2, 4, 8, 16, 32, 64};
+
+    bench::add("treiber_stack/push_pop", [](bench::context &ctx) {
+        thread_local task_object object{ctx.thread_index, {}};
+        free_list.push(&object);
+        bench::do_not_optimize(free_list.pop());
+    }).threads(thread_counts);
+
+    bench::add("treiber_stack_ebr/push_pop", [](bench::context &ctx) {
+        thread_local task_object object{ctx.thread_index, {}};
+        free_list_ebr.push(&object);
+        bench::do_not_optimize(free_list_ebr.pop());
+    }).threads(thread_counts);
+
+    bench::add("mutex_vector/push_pop", [](bench::context &ctx) {
+        thread_local task_object object{ctx.thread_index, {}};
+        {
+            std::lock_guard<std::mutex> lg(*mut);
+            locked_free_list.push_back(&object);
+        }
+        task_object *t = nullptr;
+        {
+            std::lock_guard<std::mutex> lg(*mut);
+            t = locked_free_list.back();
+            locked_free_list.pop_back();
+        }
+        bench::do_not_optimize(t);
+    }).threads(thread_counts);
+
+    return bench::run(argc, argv);
+}
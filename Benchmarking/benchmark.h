@@ -0,0 +1,550 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "perf_counters.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
+/*
+ * Microbenchmark Harness
+ *
+ * - Header-only, used by the bench targets in every project
+ *          target_include_directories(my_bench PRIVATE ${CMAKE_CURRENT_SOURCE_DIR}/../Benchmarking)
+ *
+ * - Register a benchmark with the operation to be timed
+ *          bench::add("spin_lock", [](bench::context &ctx) {
+ *              lock.lock();
+ *              lock.unlock();
+ *          }).threads({1, 2, 4});
+ *
+ *          int main(int argc, char *argv[]) { return bench::run(argc, argv); }
+ *
+ * - For each thread count
+ *      - Warmup, then calibrate a batch size so that one timed batch takes at least ~1us
+ *      - Take timed samples until --min-time has passed
+ *      - Each sample is the time per operation within one batch
+ *      - Report p50 / p99 / p999 / max per operation, and total throughput
+ *
+ * - Timing uses rdtsc on x86, calibrated against std::chrono::steady_clock
+ *      - steady_clock everywhere else
+ *
+ * - Command line
+ *      --filter=<text>     Only run benchmarks whose name contains <text>
+ *      --min-time=<sec>    Measuring time for each benchmark and thread count (default 0.2)
+ *      --max-threads=<n>   Skip thread counts above n
+ *      --pin               Pin benchmark thread i to CPU i
+ *      --json              One JSON object per line instead of a table
+ *      --no-perf           Do not attach hardware counters (perf_counters.h) to the results
+ *
+ * - Hardware counters are attached to each result when available
+ *      - cycles, instructions and cache misses per operation
+ *      - context switches in total, over all threads
+ *      */
+
+namespace bench {
+
+    // Prevent the compiler from optimizing away a value which is never used
+    template<typename T>
+    inline void do_not_optimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    template<typename T>
+    inline void do_not_optimize(T &value)
+    {
+#if defined(__clang__)
+        asm volatile("" : "+r,m"(value) : : "memory");
+#else
+        asm volatile("" : "+m,r"(value) : : "memory");
+#endif
+    }
+
+    // Force all pending writes to memory - stops the compiler merging or removing stores
+    inline void clobber_memory()
+    {
+        asm volatile("" : : : "memory");
+    }
+
+    // Ticks are rdtsc cycles where available, nanoseconds otherwise
+    class clock {
+    public:
+        static std::uint64_t now()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_lfence();
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+        static double ns_per_tick()
+        {
+            static const double value = calibrate();
+            return value;
+        }
+
+        static double to_ns(std::uint64_t ticks) { return static_cast<double>(ticks) * ns_per_tick(); }
+
+        static const char *source()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return "rdtsc";
+#else
+            return "steady_clock";
+#endif
+        }
+
+    private:
+        static double calibrate()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            using namespace std::literals;
+            auto t0 = std::chrono::steady_clock::now();
+            auto c0 = now();
+            while (std::chrono::steady_clock::now() - t0 < 20ms) {}
+            auto t1 = std::chrono::steady_clock::now();
+            auto c1 = now();
+            return std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(c1 - c0);
+#else
+            return 1.0;
+#endif
+        }
+    };
+
+    // Number of hardware threads, at least 1
+    inline int hardware_threads()
+    {
+        return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    // Pin the calling thread to one CPU. Returns false if not supported
+    inline bool pin_to_cpu(int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % hardware_threads(), &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    // Passed to the operation being timed
+    struct context {
+        int thread_index;           // 0 .. threads - 1
+        int threads;                // Number of threads running this benchmark
+    };
+
+    struct result {
+        std::string name;
+        int threads = 1;
+        std::uint64_t iterations = 0;   // Total operations timed, over all threads
+        std::uint64_t batch = 1;        // Operations per timed sample
+        double p50 = 0, p99 = 0, p999 = 0, max = 0, mean = 0;     // ns per operation
+        double ops_per_sec = 0;         // Over all threads
+        double seconds = 0;             // Wall time of the timed section
+
+        // Extra values reported with the result, e.g. hardware counters
+        std::map<std::string, double> counters;
+    };
+
+    // Called on every benchmark thread, immediately before and after its timed section
+    // Used to attach per-thread measurements (e.g. hardware counters) to the result
+    struct instrument {
+        virtual ~instrument() = default;
+        virtual void start(int thread_index) = 0;
+        virtual void stop(int thread_index) = 0;
+        virtual void report(result &r) = 0;     // Called once, after all threads have stopped
+    };
+
+    struct options {
+        std::string filter;
+        double min_time = 0.2;
+        int max_threads = 0;            // 0 means no limit
+        bool pin = false;
+        bool json = false;
+        bool perf = true;
+    };
+
+    class benchmark {
+    public:
+        using body_type = std::function<void(context &)>;
+        using setup_type = std::function<void(int threads)>;
+        using teardown_type = std::function<void(result &)>;
+        using instrument_factory = std::function<std::unique_ptr<instrument>(int threads)>;
+
+        benchmark(std::string name, body_type body) : name_(std::move(name)), body_(std::move(body)) {}
+
+        // Thread counts to run with (default: 1)
+        benchmark &threads(std::vector<int> counts) { thread_counts = std::move(counts); return *this; }
+
+        // 1, 2, 4, ... up to max, plus max itself
+        benchmark &threads_range(int max)
+        {
+            thread_counts.clear();
+            for (int n = 1; n < max; n *= 2)
+                thread_counts.push_back(n);
+            thread_counts.push_back(std::max(1, max));
+            return *this;
+        }
+
+        // Called before each thread count is run, e.g. to reset shared state
+        benchmark &setup(setup_type f) { setup_ = std::move(f); return *this; }
+
+        // Called after each thread count is run, can add counters to the result
+        benchmark &teardown(teardown_type f) { teardown_ = std::move(f); return *this; }
+
+        benchmark &instrument_with(instrument_factory f) { instruments.push_back(std::move(f)); return *this; }
+
+        const std::string &name() const { return name_; }
+
+        std::vector<result> run(const options &opts) const;
+
+    private:
+        result run_threads(int n, const options &opts) const;
+
+        std::string name_;
+        body_type body_;
+        std::vector<int> thread_counts{1};
+        setup_type setup_;
+        teardown_type teardown_;
+        std::vector<instrument_factory> instruments;
+    };
+
+    // A deque, so the reference returned by add() stays valid
+    inline std::deque<benchmark> &registry()
+    {
+        static std::deque<benchmark> benchmarks;
+        return benchmarks;
+    }
+
+    // Instruments added here are used by every registered benchmark
+    inline std::vector<benchmark::instrument_factory> &global_instruments()
+    {
+        static std::vector<benchmark::instrument_factory> factories;
+        return factories;
+    }
+
+    inline benchmark &add(std::string name, benchmark::body_type body)
+    {
+        registry().emplace_back(std::move(name), std::move(body));
+        return registry().back();
+    }
+
+    // Hardware counters for each benchmark thread, summed over the threads
+    class perf_instrument : public instrument {
+    public:
+        explicit perf_instrument(int threads) : groups(threads) {}
+
+        void start(int thread_index) override
+        {
+            // Opened here so that the counters follow this thread
+            groups[thread_index] = std::make_unique<perf::counter_group>();
+            groups[thread_index]->start();
+        }
+
+        void stop(int thread_index) override { groups[thread_index]->stop(); }
+
+        void report(result &r) override
+        {
+            std::map<std::string, double> totals;
+            for (auto &g : groups) {
+                for (auto &[key, value] : g->values())
+                    totals[key] += value;
+            }
+            auto ops = static_cast<double>(std::max<std::uint64_t>(1, r.iterations));
+            for (auto &[key, value] : totals) {
+                if (key == "context_switches")
+                    r.counters[key] = value;
+                else
+                    r.counters[key + "_per_op"] = value / ops;
+            }
+        }
+
+    private:
+        std::vector<std::unique_ptr<perf::counter_group>> groups;
+    };
+
+    // CPU time used by the benchmark threads, from getrusage(RUSAGE_THREAD)
+    // Shows how much CPU waiters burn, e.g. spinning on a lock
+    //      .instrument_with(bench::cpu_time_instrument::make)
+    class cpu_time_instrument : public instrument {
+    public:
+        explicit cpu_time_instrument(int threads) : begin(threads, 0), used(threads, 0) {}
+
+        void start(int thread_index) override { begin[thread_index] = thread_cpu_seconds(); }
+        void stop(int thread_index) override { used[thread_index] = thread_cpu_seconds() - begin[thread_index]; }
+
+        void report(result &r) override
+        {
+            double total = 0;
+            for (double u : used)
+                total += u;
+            r.counters["cpu_seconds"] = total;
+            if (r.seconds > 0)
+                r.counters["cpu_utilization"] = total / (r.seconds * r.threads);
+        }
+
+        static std::unique_ptr<instrument> make(int threads) { return std::make_unique<cpu_time_instrument>(threads); }
+
+        static double thread_cpu_seconds()
+        {
+#ifdef __linux__
+            rusage usage{};
+            getrusage(RUSAGE_THREAD, &usage);
+            return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+                   + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#else
+            return 0;
+#endif
+        }
+
+    private:
+        std::vector<double> begin, used;
+    };
+
+    inline double percentile(const std::vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    inline result benchmark::run_threads(int n, const options &opts) const
+    {
+        using namespace std::literals;
+        const auto min_ticks = static_cast<std::uint64_t>(opts.min_time * 1e9 / clock::ns_per_tick());
+        const auto sample_ticks = static_cast<std::uint64_t>(1000.0 / clock::ns_per_tick());     // ~1us
+        const std::size_t max_samples = 1'000'000;
+
+        std::vector<std::unique_ptr<instrument>> active;
+        for (auto &f : global_instruments())
+            active.push_back(f(n));
+        for (auto &f : instruments)
+            active.push_back(f(n));
+
+        std::vector<std::vector<double>> samples(n);
+        std::vector<std::uint64_t> iterations(n, 0), batches(n, 1), begin(n, 0), end(n, 0);
+        std::barrier sync(n);
+
+        auto worker = [&](int index) {
+            if (opts.pin)
+                pin_to_cpu(index);
+            context ctx{index, n};
+
+            // Warmup, and find a batch size which takes at least sample_ticks
+            std::uint64_t batch = 1;
+            auto warmup_end = clock::now() + min_ticks / 10;
+            while (true) {
+                auto t0 = clock::now();
+                for (std::uint64_t i = 0; i < batch; ++i)
+                    body_(ctx);
+                auto t1 = clock::now();
+                if (t1 - t0 < sample_ticks && batch < (1u << 30))
+                    batch *= 2;
+                else if (t1 >= warmup_end)
+                    break;
+            }
+            batches[index] = batch;
+
+            auto &mine = samples[index];
+            mine.reserve(1024);
+
+            sync.arrive_and_wait();
+            for (auto &i : active)
+                i->start(index);
+            begin[index] = clock::now();
+
+            std::uint64_t now = begin[index];
+            while (now - begin[index] < min_ticks && mine.size() < max_samples) {
+                auto t0 = clock::now();
+                for (std::uint64_t i = 0; i < batch; ++i)
+                    body_(ctx);
+                now = clock::now();
+                mine.push_back(clock::to_ns(now - t0) / static_cast<double>(batch));
+                iterations[index] += batch;
+            }
+
+            end[index] = now;
+            for (auto &i : active)
+                i->stop(index);
+            sync.arrive_and_wait();
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < n; ++i)
+            threads.emplace_back(worker, i);
+        worker(0);
+        for (auto &t : threads)
+            t.join();
+
+        result r;
+        r.name = name_;
+        r.threads = n;
+        std::vector<double> all;
+        for (int i = 0; i < n; ++i) {
+            all.insert(all.end(), samples[i].begin(), samples[i].end());
+            r.iterations += iterations[i];
+        }
+        r.batch = *std::max_element(batches.begin(), batches.end());
+        std::sort(all.begin(), all.end());
+
+        double total = 0;
+        for (double s : all)
+            total += s;
+        r.mean = all.empty() ? 0 : total / static_cast<double>(all.size());
+        r.p50 = percentile(all, 0.50);
+        r.p99 = percentile(all, 0.99);
+        r.p999 = percentile(all, 0.999);
+        r.max = all.empty() ? 0 : all.back();
+
+        auto first = *std::min_element(begin.begin(), begin.end());
+        auto last = *std::max_element(end.begin(), end.end());
+        r.seconds = clock::to_ns(last - first) / 1e9;
+        r.ops_per_sec = r.seconds > 0 ? static_cast<double>(r.iterations) / r.seconds : 0;
+
+        for (auto &i : active)
+            i->report(r);
+        return r;
+    }
+
+    inline std::vector<result> benchmark::run(const options &opts) const
+    {
+        std::vector<result> results;
+        for (int n : thread_counts) {
+            if (opts.max_threads > 0 && n > opts.max_threads)
+                continue;
+            if (setup_)
+                setup_(n);
+            auto r = run_threads(n, opts);
+            if (teardown_)
+                teardown_(r);
+            results.push_back(std::move(r));
+        }
+        return results;
+    }
+
+    inline std::string format_ns(double ns)
+    {
+        std::ostringstream os;
+        os << std::fixed << std::setprecision(1);
+        if (ns < 1e3)
+            os << ns << " ns";
+        else if (ns < 1e6)
+            os << ns / 1e3 << " us";
+        else
+            os << ns / 1e6 << " ms";
+        return os.str();
+    }
+
+    inline void print(const result &r, bool json)
+    {
+        if (json) {
+            std::cout << "{\"name\":\"" << r.name << "\",\"threads\":" << r.threads
+                      << ",\"iterations\":" << r.iterations << ",\"batch\":" << r.batch
+                      << ",\"mean_ns\":" << r.mean << ",\"p50_ns\":" << r.p50
+                      << ",\"p99_ns\":" << r.p99 << ",\"p999_ns\":" << r.p999
+                      << ",\"max_ns\":" << r.max << ",\"ops_per_sec\":" << r.ops_per_sec
+                      << ",\"clock\":\"" << clock::source() << "\"";
+            for (auto &[key, value] : r.counters)
+                std::cout << ",\"" << key << "\":" << value;
+            std::cout << "}" << std::endl;
+            return;
+        }
+
+        std::cout << std::left << std::setw(40) << r.name << std::right
+                  << std::setw(4) << r.threads
+                  << std::setw(12) << format_ns(r.p50)
+                  << std::setw(12) << format_ns(r.p99)
+                  << std::setw(12) << format_ns(r.p999)
+                  << std::setw(12) << format_ns(r.max)
+                  << std::setw(14) << std::fixed << std::setprecision(0) << r.ops_per_sec;
+        for (auto &[key, value] : r.counters)
+            std::cout << "  " << key << "=" << std::setprecision(2) << value;
+        std::cout << std::endl;
+    }
+
+    inline options parse_options(int argc, char *argv[])
+    {
+        options opts;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&arg](const char *prefix) { return arg.substr(std::string(prefix).size()); };
+
+            if (arg.rfind("--filter=", 0) == 0)
+                opts.filter = value("--filter=");
+            else if (arg.rfind("--min-time=", 0) == 0)
+                opts.min_time = std::stod(value("--min-time="));
+            else if (arg.rfind("--max-threads=", 0) == 0)
+                opts.max_threads = std::stoi(value("--max-threads="));
+            else if (arg == "--pin")
+                opts.pin = true;
+            else if (arg == "--json")
+                opts.json = true;
+            else if (arg == "--no-perf")
+                opts.perf = false;
+            else
+                std::cerr << "Ignoring unknown option " << arg << std::endl;
+        }
+        return opts;
+    }
+
+    // Run every registered benchmark which matches the filter
+    inline int run(int argc, char *argv[])
+    {
+        auto opts = parse_options(argc, argv);
+        if (opts.perf) {
+            global_instruments().emplace_back([](int threads) {
+                return std::make_unique<perf_instrument>(threads);
+            });
+        }
+
+        if (!opts.json) {
+            std::cout << std::left << std::setw(40) << "benchmark" << std::right
+                      << std::setw(4) << "thr" << std::setw(12) << "p50" << std::setw(12) << "p99"
+                      << std::setw(12) << "p999" << std::setw(12) << "max" << std::setw(14) << "ops/s"
+                      << std::endl;
+        }
+
+        for (const auto &b : registry()) {
+            if (!opts.filter.empty() && b.name().find(opts.filter) == std::string::npos)
+                continue;
+            for (const auto &r : b.run(opts))
+                print(r, opts.json);
+        }
+        return 0;
+    }
+}
+
+#endif //BENCHMARK_H
@@ -0,0 +1,211 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Hardware Performance Counters
+ *
+ * - Wall time says which version is faster, the counters say why
+ *      - cycles, instructions      instructions per cycle shows stalls
+ *      - cache_misses              e.g. the cache line holding a lock moving between cores
+ *      - context_switches          e.g. a mutex putting the thread to sleep
+ *
+ * - Linux perf_event_open() counts events for the calling thread only
+ *      - The hardware events are opened as one group, so they are read together
+ *      - If the kernel multiplexes the counters, the values are scaled up
+ *
+ * - Counters may not be available
+ *      - Not Linux, running in a VM or container, /proc/sys/kernel/perf_event_paranoid too high
+ *      - The missing values are left out of the results
+ *      - context_switches falls back to getrusage(RUSAGE_THREAD)
+ *
+ *          perf::counter_group counters;
+ *          {
+ *              perf::scope s(counters);
+ *              // Hot section
+ *          }
+ *          for (auto &[name, value] : counters.values())
+ *              std::cout << name << " = " << value << std::endl;
+ *      */
+
+namespace perf {
+
+    enum class event { cycles, instructions, cache_references, cache_misses, branch_misses, context_switches };
+
+    inline const char *name(event e)
+    {
+        switch (e) {
+            case event::cycles:           return "cycles";
+            case event::instructions:     return "instructions";
+            case event::cache_references: return "cache_references";
+            case event::cache_misses:     return "cache_misses";
+            case event::branch_misses:    return "branch_misses";
+            case event::context_switches: return "context_switches";
+        }
+        return "unknown";
+    }
+
+    inline std::vector<event> default_events()
+    {
+        return {event::cycles, event::instructions, event::cache_misses, event::context_switches};
+    }
+
+    // Counts events for the thread which calls start() and stop()
+    class counter_group {
+    public:
+        explicit counter_group(std::vector<event> events = default_events()) : events(std::move(events))
+        {
+            results.assign(this->events.size(), 0.0);
+            fds.assign(this->events.size(), -1);
+#ifdef __linux__
+            for (std::size_t i = 0; i < this->events.size(); ++i) {
+                if (this->events[i] == event::context_switches)
+                    continue;       // Software event, opened on its own below
+                fds[i] = open(this->events[i], leader);
+                if (fds[i] >= 0 && leader < 0)
+                    leader = fds[i];
+            }
+            for (std::size_t i = 0; i < this->events.size(); ++i) {
+                if (this->events[i] == event::context_switches)
+                    fds[i] = open(event::context_switches, -1);
+            }
+#endif
+        }
+
+        ~counter_group()
+        {
+#ifdef __linux__
+            for (int fd : fds) {
+                if (fd >= 0)
+                    close(fd);
+            }
+#endif
+        }
+
+        counter_group(const counter_group &) = delete;
+        counter_group &operator=(const counter_group &) = delete;
+
+        // Are the hardware counters working?
+        bool hardware_available() const { return leader >= 0; }
+
+        void start()
+        {
+#ifdef __linux__
+            for (int fd : fds) {
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+            rusage_switches = thread_context_switches();
+#endif
+        }
+
+        void stop()
+        {
+#ifdef __linux__
+            for (int fd : fds) {
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+            for (std::size_t i = 0; i < events.size(); ++i) {
+                if (fds[i] >= 0)
+                    results[i] = read_scaled(fds[i]);
+                else if (events[i] == event::context_switches)
+                    results[i] = static_cast<double>(thread_context_switches() - rusage_switches);
+            }
+#endif
+        }
+
+        // Values from the last start()/stop() - unavailable counters are left out
+        std::vector<std::pair<std::string, double>> values() const
+        {
+            std::vector<std::pair<std::string, double>> out;
+            for (std::size_t i = 0; i < events.size(); ++i) {
+#ifdef __linux__
+                if (fds[i] >= 0 || events[i] == event::context_switches)
+                    out.emplace_back(name(events[i]), results[i]);
+#endif
+            }
+            return out;
+        }
+
+    private:
+#ifdef __linux__
+        static int open(event e, int group_fd)
+        {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            switch (e) {
+                case event::cycles:           attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+                case event::instructions:     attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+                case event::cache_references: attr.config = PERF_COUNT_HW_CACHE_REFERENCES; break;
+                case event::cache_misses:     attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+                case event::branch_misses:    attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+                case event::context_switches:
+                    attr.type = PERF_TYPE_SOFTWARE;
+                    attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+                    break;
+            }
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // pid 0, cpu -1: this thread, on any CPU
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+        }
+
+        static double read_scaled(int fd)
+        {
+            std::uint64_t data[3] = {0, 0, 0};     // value, time enabled, time running
+            if (read(fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+                return 0;
+            if (data[2] == 0)
+                return 0;
+            return static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+        }
+
+        static long thread_context_switches()
+        {
+            rusage usage{};
+            getrusage(RUSAGE_THREAD, &usage);
+            return usage.ru_nvcsw + usage.ru_nivcsw;
+        }
+
+        long rusage_switches = 0;
+#endif
+        std::vector<event> events;
+        std::vector<int> fds;
+        std::vector<double> results;
+        int leader = -1;
+    };
+
+    // RAII - counts events for the lifetime of the scope
+    class scope {
+    public:
+        explicit scope(counter_group &group) : group(group) { group.start(); }
+        ~scope() { group.stop(); }
+
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+
+    private:
+        counter_group &group;
+    };
+}
+
+#endif //PERF_COUNTERS_H
@@ -4,6 +4,7 @@
 #include <thread>
 #include <string>
 #include <future>
+#include "speculative_async.h"
 using namespace std::literals;
 
 /*
@@ -75,6 +76,17 @@ using namespace std::literals;
  * - In lazy evaluation, the task does not run until get() is called
  * */
 
+/*
+ * Speculative Launch (speculative_async.h)
+ *
+ * - Lazy like std::launch::deferred
+ *      - The task is not guaranteed to start before get() is called
+ * - But an idle worker thread may start it early
+ *      - get() only runs the task itself if no worker has claimed it
+ *      - If spare cores are available, we get the latency of std::launch::async
+ * - wait_for() returns std::future_status::deferred until somebody starts the task
+ * */
+
 /*
  * Choosing a Thread Object
  *
@@ -162,6 +174,16 @@ int task()
 
 void func(const std::string &option = "default"s)
 {
+    if (option == "speculative"s) {
+        auto result = speculative_async(task);
+
+        std::cout << "Calling async with option \"" << option << "\"" << std::endl;
+        std::this_thread::sleep_for(2s);
+        std::cout << "Calling get()" << std::endl;
+        std::cout << "Task result: " << result.get() << std::endl;
+        return;
+    }
+
     std::future<int> result;
 
     if (option == "async"s) {
@@ -233,6 +255,7 @@ int main() {
     func("async");
     func("deferred");
     func("default");
+    func("speculative");
 
     int value = 200;
     int *ptr1 = &value;
@@ -0,0 +1,209 @@
+#ifndef SPECULATIVE_ASYNC_H
+#define SPECULATIVE_ASYNC_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Lazy-but-speculative Launch Policy
+ *
+ * - std::launch::deferred does nothing until get() is called
+ *      - Any time between std::async() and get() is wasted
+ * - std::launch::async always starts a new thread
+ *
+ * - Speculative execution
+ *      - The task is deferred, and also placed on a queue
+ *      - An idle worker thread may take it from the queue and run it early
+ *      - get() runs the task inline, only if no worker has started it
+ *
+ * - Each task has an atomic state: pending, running or done
+ *      - Whoever moves it from pending to running (compare_exchange) executes it
+ *      - The task runs exactly once, either in a worker or in the thread calling get()
+ *      */
+
+class speculative_executor;
+
+namespace speculative_detail {
+    enum class task_state { pending, running, done };
+
+    struct task_base {
+        std::atomic<task_state> state{task_state::pending};
+
+        virtual ~task_base() = default;
+        virtual void invoke() = 0;
+
+        // Returns true if this thread now owns the task
+        bool try_claim()
+        {
+            auto expected = task_state::pending;
+            return state.compare_exchange_strong(expected, task_state::running,
+                                                 std::memory_order_acq_rel);
+        }
+
+        void run()
+        {
+            invoke();
+            state.store(task_state::done, std::memory_order_release);
+        }
+    };
+
+    template<typename R>
+    struct task : task_base {
+        std::packaged_task<R()> ptask;
+
+        explicit task(std::packaged_task<R()> &&p) : ptask(std::move(p)) {}
+
+        void invoke() override { ptask(); }
+    };
+}
+
+// Returned by speculative_executor::submit()
+// Behaves like the std::future from a deferred std::async() call
+template<typename R>
+class speculative_future {
+public:
+    speculative_future() = default;
+
+    bool valid() const { return fut.valid(); }
+
+    // Has a worker (or get()) already started the task?
+    bool started() const
+    {
+        return state->state.load(std::memory_order_acquire) != speculative_detail::task_state::pending;
+    }
+
+    void wait()
+    {
+        if (state->try_claim())
+            state->run();
+        fut.wait();
+    }
+
+    // Does not run the task - returns std::future_status::deferred if nobody has started it
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period> &duration) const
+    {
+        if (!started())
+            return std::future_status::deferred;
+        return fut.wait_for(duration);
+    }
+
+    R get()
+    {
+        if (state->try_claim())
+            state->run();           // Nobody took it - lazy evaluation in this thread
+        return fut.get();           // Otherwise wait for the worker to finish it
+    }
+
+private:
+    friend class speculative_executor;
+
+    speculative_future(std::shared_ptr<speculative_detail::task_base> s, std::future<R> f)
+            : state(std::move(s)), fut(std::move(f)) {}
+
+    std::shared_ptr<speculative_detail::task_base> state;
+    std::future<R> fut;
+};
+
+class speculative_executor {
+public:
+    explicit speculative_executor(unsigned n_workers = default_workers())
+    {
+        for (unsigned i = 0; i < n_workers; ++i)
+            workers.emplace_back(&speculative_executor::worker, this);
+    }
+
+    ~speculative_executor()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            done = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers)
+            w.join();
+        // Tasks still in the queue stay deferred - get() will run them
+    }
+
+    speculative_executor(const speculative_executor &) = delete;
+    speculative_executor &operator=(const speculative_executor &) = delete;
+
+    template<typename Func, typename... Args>
+    auto submit(Func &&func, Args &&...args)
+    {
+        using R = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+
+        std::packaged_task<R()> ptask(
+                [f = std::forward<Func>(func), ... a = std::forward<Args>(args)]() mutable -> R {
+                    return std::invoke(std::move(f), std::move(a)...);
+                });
+        auto fut = ptask.get_future();
+        auto t = std::make_shared<speculative_detail::task<R>>(std::move(ptask));
+
+        {
+            std::lock_guard<std::mutex> lg(mut);
+            queue.push_back(t);
+        }
+        cv.notify_one();
+        return speculative_future<R>(std::move(t), std::move(fut));
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Leave one core for the thread which will call get()
+    static unsigned default_workers()
+    {
+        return std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    static speculative_executor &instance()
+    {
+        static speculative_executor executor;
+        return executor;
+    }
+
+private:
+    void worker()
+    {
+        while (true) {
+            std::shared_ptr<speculative_detail::task_base> t;
+            {
+                std::unique_lock<std::mutex> ul(mut);
+                cv.wait(ul, [this] { return done || !queue.empty(); });
+                if (done)
+                    return;
+                t = std::move(queue.front());
+                queue.pop_front();
+            }
+            // Skip tasks which get() has already run inline
+            if (t->try_claim())
+                t->run();
+        }
+    }
+
+    std::mutex mut;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<speculative_detail::task_base>> queue;
+    std::vector<std::thread> workers;
+    bool done = false;
+};
+
+// Same syntax as std::async(), using the shared executor
+template<typename Func, typename... Args>
+auto speculative_async(Func &&func, Args &&...args)
+{
+    return speculative_executor::instance().submit(std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+#endif //SPECULATIVE_ASYNC_H
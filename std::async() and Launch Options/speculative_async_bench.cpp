@@ -0,0 +1,35 @@
+#include <future>
+#include "speculative_async.h"
+#include "benchmark.h"
+
+/*
+ * speculative_async() vs std::async()
+ *
+ * - Launch a task and immediately call get()
+ *      - std::launch::deferred runs the task inline
+ *      - std::launch::async starts a thread
+ *      - speculative_async() either finds the task already claimed by a worker,
+ *        or runs it inline
+ *      */
+
+int multiply_by_2(int a)
+{
+    return a * 2;
+}
+
+int main(int argc, char *argv[])
+{
+    bench::add("std_async/deferred", [](bench::context &ctx) {
+        bench::do_not_optimize(std::async(std::launch::deferred, multiply_by_2, ctx.thread_index).get());
+    }).threads_range(bench::hardware_threads());
+
+    bench::add("std_async/async", [](bench::context &ctx) {
+        bench::do_not_optimize(std::async(std::launch::async, multiply_by_2, ctx.thread_index).get());
+    }).threads_range(bench::hardware_threads());
+
+    bench::add("speculative_async", [](bench::context &ctx) {
+        bench::do_not_optimize(speculative_async(multiply_by_2, ctx.thread_index).get());
+    }).threads_range(bench::hardware_threads());
+
+    return bench::run(argc, argv);
+}
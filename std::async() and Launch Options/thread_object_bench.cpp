@@ -0,0 +1,207 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "speculative_async.h"
+#include "benchmark.h"
+
+/*
+ * Choosing a Thread Object - the numbers
+ *
+ * - Each way of executing a task is measured the same way
+ *      - thread: std::thread
+ *      - packaged_task: std::packaged_task on a new std::thread
+ *      - async_async, async_deferred, async_default: std::async() with each launch policy
+ *      - speculative_executor (the only thread pool in the project)
+ *
+ * - <object>/round_trip: create the thread object, run the task, get the result
+ *      - p50 etc. are the round trip time
+ *      - With N benchmark threads there are N tasks in flight, so ops/s is the throughput
+ *      - launch_ns: mean time from creating the thread object to the task starting
+ *
+ * - <object>/in_flight_64: launch 64 tasks, then wait for all of them (one operation)
+ *      - heap_per_task: bytes from operator new for each task in flight
+ *      - rss_per_task: growth in resident memory for each task in flight (includes stacks)
+ *      - Measured once before timing, with every task blocked until all 64 have been launched
+ *
+ * - Reports like every other bench target - use --json for one JSON object per line
+ *      */
+
+using namespace std::literals;
+
+// Count heap allocations made while tasks are being launched
+// Every replaceable allocation and deallocation function is replaced, all with malloc and free,
+// so whatever form of delete the library uses matches the new
+std::atomic<long long> heap_bytes{0};
+
+void *counted_alloc(std::size_t size, std::size_t align = 0)
+{
+    heap_bytes.fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+    void *p = align ? std::aligned_alloc(align, (size + align - 1) / align * align) : std::malloc(size);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(std::size_t size) { return counted_alloc(size); }
+void *operator new[](std::size_t size) { return counted_alloc(size); }
+void *operator new(std::size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<std::size_t>(align)); }
+void *operator new[](std::size_t size, std::align_val_t align) { return counted_alloc(size, static_cast<std::size_t>(align)); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+long long resident_bytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    long long pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+struct thread_object {
+    static constexpr const char *name = "thread";
+
+    template<typename Func>
+    static std::thread start(Func f) { return std::thread(std::move(f)); }
+
+    static void finish(std::thread &t) { t.join(); }
+};
+
+struct packaged_task_object {
+    static constexpr const char *name = "packaged_task";
+
+    template<typename Func>
+    static auto start(Func f)
+    {
+        std::packaged_task<int()> ptask(std::move(f));
+        auto fut = ptask.get_future();
+        return std::make_pair(std::thread(std::move(ptask)), std::move(fut));
+    }
+
+    static void finish(std::pair<std::thread, std::future<int>> &p)
+    {
+        p.second.get();
+        p.first.join();
+    }
+};
+
+template<std::launch policy>
+struct async_object {
+    static constexpr const char *name =
+            policy == std::launch::async ? "async_async" :
+            policy == std::launch::deferred ? "async_deferred" : "async_default";
+
+    template<typename Func>
+    static std::future<int> start(Func f) { return std::async(policy, std::move(f)); }
+
+    static void finish(std::future<int> &fut) { fut.get(); }
+};
+
+struct pool_object {
+    static constexpr const char *name = "speculative_executor";
+
+    template<typename Func>
+    static speculative_future<int> start(Func f) { return speculative_executor::instance().submit(std::move(f)); }
+
+    static void finish(speculative_future<int> &fut) { fut.get(); }
+};
+
+constexpr int in_flight = 64;
+
+// Heap and resident memory per task, with in_flight tasks blocked at once
+template<typename Object>
+std::pair<double, double> memory_per_task()
+{
+    using handle_type = decltype(Object::start([] { return 0; }));
+
+    // Every task blocks until all of them have been launched
+    std::promise<void> gate;
+    std::shared_future<void> release = gate.get_future().share();
+
+    std::vector<handle_type> handles;
+    handles.reserve(in_flight);
+
+    auto rss_before = resident_bytes();
+    auto heap_before = heap_bytes.load();
+    for (int i = 0; i < in_flight; ++i)
+        handles.push_back(Object::start([release] { release.wait(); return 42; }));
+    auto heap_after = heap_bytes.load();
+    std::this_thread::sleep_for(20ms);          // Let the threads touch their stacks
+    auto rss_after = resident_bytes();
+
+    gate.set_value();
+    for (auto &h : handles)
+        Object::finish(h);
+
+    return {double(heap_after - heap_before) / in_flight, double(rss_after - rss_before) / in_flight};
+}
+
+template<typename Object>
+void add_benchmarks()
+{
+    using handle_type = decltype(Object::start([] { return 0; }));
+    const std::string name = Object::name;
+
+    // Launch latency, summed over all benchmark threads
+    static std::atomic<std::uint64_t> launch_ticks{0};
+    static std::atomic<std::uint64_t> launches{0};
+
+    bench::add(name + "/round_trip", [](bench::context &) {
+        std::atomic<std::uint64_t> started{0};
+        auto begin = bench::clock::now();
+        auto handle = Object::start([&started] { started.store(bench::clock::now()); return 42; });
+        Object::finish(handle);
+        launch_ticks.fetch_add(started.load() - begin, std::memory_order_relaxed);
+        launches.fetch_add(1, std::memory_order_relaxed);
+    }).threads_range(bench::hardware_threads()).setup([](int) {
+        launch_ticks = 0;
+        launches = 0;
+    }).teardown([](bench::result &r) {
+        if (launches > 0)
+            r.counters["launch_ns"] = bench::clock::to_ns(launch_ticks) / double(launches);
+    });
+
+    static std::pair<double, double> memory;
+
+    bench::add(name + "/in_flight_64", [](bench::context &) {
+        std::vector<handle_type> handles;
+        handles.reserve(in_flight);
+        for (int i = 0; i < in_flight; ++i)
+            handles.push_back(Object::start([] { return 42; }));
+        for (auto &h : handles)
+            Object::finish(h);
+    }).setup([](int) {
+        memory = memory_per_task<Object>();
+    }).teardown([](bench::result &r) {
+        r.counters["heap_per_task"] = memory.first;
+        r.counters["rss_per_task"] = memory.second;
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    add_benchmarks<thread_object>();
+    add_benchmarks<packaged_task_object>();
+    add_benchmarks<async_object<std::launch::async>>();
+    add_benchmarks<async_object<std::launch::deferred>>();
+    add_benchmarks<async_object<std::launch::async | std::launch::deferred>>();
+    add_benchmarks<pool_object>();
+
+    return bench::run(argc, argv);
+}
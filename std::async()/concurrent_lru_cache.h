@@ -0,0 +1,279 @@
+#ifndef CONCURRENT_LRU_CACHE_H
+#define CONCURRENT_LRU_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Sharded Concurrent LRU Cache
+ *
+ * - Keep the results of tasks like fibonacci(n) after get(), up to a fixed number of entries
+ *
+ * - With one mutex for the whole cache
+ *      - Every lookup also moves the entry to the front of the LRU list - a write
+ *      - So lookups from different threads are serialised
+ *
+ * - Sharding
+ *      - The cache is split into shards by key hash, each with its own lock, map and list
+ *      - Threads looking up different keys usually use different shards
+ *      - Each shard holds capacity / shards entries, so eviction is only approximately LRU overall
+ *
+ * - Intrusive list
+ *      - The entries of a shard live in a std::deque, allocated once up to the shard's capacity
+ *      - Each entry has the indexes of its neighbours in the LRU list
+ *      - Evicted entries are reused, so memory use does not change once the cache is full
+ *
+ * - eviction_policy::clock
+ *      - A hit only sets the entry's "referenced" bit - no list update
+ *      - So hits only need a shared lock, and can run at the same time
+ *      - To evict, a "hand" sweeps round the entries, clearing referenced bits,
+ *        until it finds an entry which has not been used since the last sweep
+ *
+ *          concurrent_lru_cache<int, unsigned long long> results(1024);
+ *          if (auto r = results.get(n)) ...
+ *          else results.put(n, std::async(fibonacci, n).get());
+ *      */
+
+enum class eviction_policy { lru, clock };
+
+template<typename K, typename V, eviction_policy Policy = eviction_policy::lru, typename Hash = std::hash<K>>
+class concurrent_lru_cache {
+public:
+    explicit concurrent_lru_cache(std::size_t capacity, std::size_t n_shards = 16, const Hash &hash = Hash())
+        : shards(round_up_pow2(n_shards)), hasher(hash)
+    {
+        auto per_shard = (capacity + shards.size() - 1) / shards.size();
+        for (auto &s : shards)
+            s.init(per_shard > 0 ? per_shard : 1);
+    }
+
+    concurrent_lru_cache(const concurrent_lru_cache &) = delete;
+    concurrent_lru_cache &operator=(const concurrent_lru_cache &) = delete;
+
+    std::optional<V> get(const K &key)
+    {
+        auto &s = shard_for(key);
+        if constexpr (Policy == eviction_policy::clock) {
+            std::shared_lock<mutex_type> sl(s.mut);
+            auto it = s.index.find(key);
+            if (it == s.index.end())
+                return std::nullopt;
+            auto &e = s.entries[it->second];
+            // Only write when the bit is clear, so the entry's cache line stays shared between readers
+            if (!e.referenced.load(std::memory_order_relaxed))
+                e.referenced.store(true, std::memory_order_relaxed);
+            return e.value;
+        }
+        else {
+            std::lock_guard<mutex_type> lg(s.mut);
+            auto it = s.index.find(key);
+            if (it == s.index.end())
+                return std::nullopt;
+            s.move_to_front(it->second);
+            return s.entries[it->second].value;
+        }
+    }
+
+    // Insert or replace, evicting an entry if the shard is full
+    void put(const K &key, V value)
+    {
+        auto &s = shard_for(key);
+        std::lock_guard<mutex_type> lg(s.mut);
+        auto it = s.index.find(key);
+        if (it != s.index.end()) {
+            auto &e = s.entries[it->second];
+            e.value = std::move(value);
+            if constexpr (Policy == eviction_policy::clock)
+                e.referenced.store(true, std::memory_order_relaxed);
+            else
+                s.move_to_front(it->second);
+            return;
+        }
+        s.insert(key, std::move(value));
+    }
+
+    // Return the cached value, or compute it with f() and cache it
+    // f() runs without the lock, so two threads may both compute a missing value
+    template<typename F>
+    V get_or_compute(const K &key, F &&f)
+    {
+        if (auto v = get(key))
+            return *std::move(v);
+        V value = std::forward<F>(f)();
+        put(key, value);
+        return value;
+    }
+
+    bool erase(const K &key)
+    {
+        auto &s = shard_for(key);
+        std::lock_guard<mutex_type> lg(s.mut);
+        auto it = s.index.find(key);
+        if (it == s.index.end())
+            return false;
+        s.remove(it->second);
+        s.index.erase(it);
+        return true;
+    }
+
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (auto &s : shards) {
+            std::lock_guard<mutex_type> lg(s.mut);
+            n += s.index.size();
+        }
+        return n;
+    }
+
+    std::size_t capacity() const noexcept { return shards.size() * shards.front().capacity; }
+
+private:
+    using mutex_type = std::conditional_t<Policy == eviction_policy::clock, std::shared_mutex, std::mutex>;
+    using index_type = std::uint32_t;
+    static constexpr index_type none = index_type(-1);
+
+    struct entry {
+        entry(const K &key, V value) : key(key), value(std::move(value)) {}
+
+        K key;
+        V value;
+        index_type prev = none;             // LRU list, or the free list
+        index_type next = none;
+        std::atomic<bool> referenced{true}; // CLOCK
+        bool in_use = true;
+    };
+
+    // Own cache line, so threads using neighbouring shards do not contend
+    struct alignas(64) shard {
+        mutable mutex_type mut;
+        std::size_t capacity = 0;
+        std::unordered_map<K, index_type, Hash> index;
+        std::deque<entry> entries;          // Never shrinks, so indexes stay valid
+        index_type head = none;             // Most recently used
+        index_type tail = none;             // Least recently used
+        index_type free_list = none;        // Erased entries
+        index_type hand = 0;                // CLOCK
+
+        void init(std::size_t n)
+        {
+            capacity = n;
+            index.reserve(n);
+        }
+
+        void unlink(index_type i) noexcept
+        {
+            auto &e = entries[i];
+            (e.prev == none ? head : entries[e.prev].next) = e.next;
+            (e.next == none ? tail : entries[e.next].prev) = e.prev;
+        }
+
+        void push_front(index_type i) noexcept
+        {
+            auto &e = entries[i];
+            e.prev = none;
+            e.next = head;
+            (head == none ? tail : entries[head].prev) = i;
+            head = i;
+        }
+
+        void move_to_front(index_type i) noexcept
+        {
+            if (head != i) {
+                unlink(i);
+                push_front(i);
+            }
+        }
+
+        void remove(index_type i) noexcept
+        {
+            if constexpr (Policy == eviction_policy::lru)
+                unlink(i);
+            entries[i].in_use = false;
+            entries[i].next = free_list;
+            free_list = i;
+        }
+
+        // Index of the entry to reuse for a new key: LRU tail, or the first unreferenced entry from the hand
+        index_type victim() noexcept
+        {
+            if constexpr (Policy == eviction_policy::lru) {
+                return tail;
+            }
+            else {
+                while (true) {
+                    auto i = hand;
+                    hand = index_type((hand + 1) % entries.size());
+                    auto &e = entries[i];
+                    if (e.in_use && !e.referenced.exchange(false, std::memory_order_relaxed))
+                        return i;
+                }
+            }
+        }
+
+        void insert(const K &key, V value)
+        {
+            index_type i;
+            if (free_list != none) {
+                i = free_list;
+                free_list = entries[i].next;
+                reuse(i, key, std::move(value));
+            }
+            else if (entries.size() < capacity) {
+                i = index_type(entries.size());
+                entries.emplace_back(key, std::move(value));
+            }
+            else {
+                i = victim();
+                index.erase(entries[i].key);
+                if constexpr (Policy == eviction_policy::lru)
+                    unlink(i);
+                reuse(i, key, std::move(value));
+            }
+            if constexpr (Policy == eviction_policy::lru)
+                push_front(i);
+            index.emplace(key, i);
+        }
+
+        void reuse(index_type i, const K &key, V value)
+        {
+            auto &e = entries[i];
+            e.key = key;
+            e.value = std::move(value);
+            e.referenced.store(true, std::memory_order_relaxed);
+            e.in_use = true;
+        }
+    };
+
+    static std::size_t round_up_pow2(std::size_t n) noexcept
+    {
+        std::size_t p = 1;
+        while (p < n)
+            p *= 2;
+        return p;
+    }
+
+    shard &shard_for(const K &key)
+    {
+        // Use the high bits of a mixed hash - the shard's map uses the low bits of the plain hash
+        std::uint64_t h = hasher(key);
+        h *= 0x9e3779b97f4a7c15ULL;
+        return shards[(h >> 32) & (shards.size() - 1)];
+    }
+
+    std::vector<shard> shards;
+    Hash hasher;
+};
+
+#endif //CONCURRENT_LRU_CACHE_H
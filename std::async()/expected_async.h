@@ -0,0 +1,90 @@
+#ifndef EXPECTED_ASYNC_H
+#define EXPECTED_ASYNC_H
+
+#include <exception>
+#include <expected>
+#include <functional>
+#include <future>
+#include <type_traits>
+#include <utility>
+
+/*
+ * std::async() and std::expected
+ *
+ * - With std::async(), a failed task throws an exception
+ *      - The exception is stored in the future as an std::exception_ptr
+ *      - get() rethrows it
+ *      - Throwing allocates the exception object and unwinds the stack
+ *
+ * - Instead, the task can return std::expected<T, E>
+ *      - The error is an ordinary value, e.g. an enum
+ *      - It is moved through the future like any other result
+ *      - No allocation for the error, no unwinding
+ *
+ *          std::expected<int, produce_error> produce_checked();
+ *
+ *          auto result = expected_async(produce_checked);
+ *          auto x = result.get();      // Does not throw
+ *          if (!x)
+ *              // Handle x.error()
+ *
+ * - Exceptions still work as a fallback
+ *      - If the task throws anyway, get() rethrows as usual
+ *      - capture_async() converts an old-style throwing task into
+ *        std::expected<T, std::exception_ptr>
+ *      */
+
+template<typename T>
+struct is_expected : std::false_type {};
+
+template<typename T, typename E>
+struct is_expected<std::expected<T, E>> : std::true_type {};
+
+// The task function must return std::expected<T, E>
+template<typename Func, typename... Args>
+auto expected_async(std::launch policy, Func &&func, Args &&...args)
+{
+    using result_type = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+    static_assert(is_expected<result_type>::value, "task function must return std::expected");
+    return std::async(policy, std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+template<typename Func, typename... Args>
+auto expected_async(Func &&func, Args &&...args)
+{
+    return expected_async(std::launch::async | std::launch::deferred,
+                          std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+// Fallback for task functions which report errors by throwing
+// Any exception is caught in the task and returned as an error value
+template<typename Func, typename... Args>
+auto capture_async(std::launch policy, Func &&func, Args &&...args)
+{
+    using value_type = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+    using result_type = std::expected<value_type, std::exception_ptr>;
+
+    return std::async(policy, [](auto f, auto... a) -> result_type {
+        try {
+            if constexpr (std::is_void_v<value_type>) {
+                std::invoke(f, a...);
+                return {};
+            }
+            else {
+                return std::invoke(f, a...);
+            }
+        }
+        catch (...) {
+            return std::unexpected(std::current_exception());
+        }
+    }, std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+template<typename Func, typename... Args>
+auto capture_async(Func &&func, Args &&...args)
+{
+    return capture_async(std::launch::async | std::launch::deferred,
+                         std::forward<Func>(func), std::forward<Args>(args)...);
+}
+
+#endif //EXPECTED_ASYNC_H
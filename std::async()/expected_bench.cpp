@@ -0,0 +1,63 @@
+#include <future>
+#include <stdexcept>
+#include <string>
+#include "expected_async.h"
+#include "benchmark.h"
+
+/*
+ * Failure path: exceptions vs std::expected
+ *
+ * - Every task fails
+ * - exception: the task throws std::out_of_range, get() rethrows it
+ * - expected:  the task returns std::unexpected, get() returns it
+ * - capture:   the task throws, capture_async() turns it into an error value
+ *
+ * - std::launch::deferred measures the cost of moving the error through the future
+ * - std::launch::async adds the cost of starting a thread
+ *      */
+
+enum class produce_error { out_of_range };
+
+int produce_throwing(int x)
+{
+    if (x >= 0)
+        throw std::out_of_range("Oops");
+    return x;
+}
+
+std::expected<int, produce_error> produce_expected(int x)
+{
+    if (x >= 0)
+        return std::unexpected(produce_error::out_of_range);
+    return x;
+}
+
+void add_benchmarks(std::launch policy, const std::string &name)
+{
+    bench::add("exception/" + name, [policy](bench::context &ctx) {
+        auto fut = std::async(policy, produce_throwing, ctx.thread_index);
+        try {
+            bench::do_not_optimize(fut.get());
+        }
+        catch (std::out_of_range &e) {
+            bench::do_not_optimize(e);
+        }
+    });
+
+    bench::add("expected/" + name, [policy](bench::context &ctx) {
+        auto fut = expected_async(policy, produce_expected, ctx.thread_index);
+        bench::do_not_optimize(fut.get());
+    });
+
+    bench::add("capture/" + name, [policy](bench::context &ctx) {
+        auto fut = capture_async(policy, produce_throwing, ctx.thread_index);
+        bench::do_not_optimize(fut.get());
+    });
+}
+
+int main(int argc, char *argv[])
+{
+    add_benchmarks(std::launch::deferred, "deferred");
+    add_benchmarks(std::launch::async, "async");
+    return bench::run(argc, argv);
+}
@@ -0,0 +1,66 @@
+#include <cstdio>
+#include <random>
+#include "concurrent_lru_cache.h"
+#include "benchmark.h"
+
+/*
+ * concurrent_lru_cache benchmark
+ *
+ * - Each operation looks up a key, and inserts a value on a miss
+ *      - 90% of lookups are for 2048 "hot" keys, the rest are spread over 64K keys
+ *      - Capacity is 4096 entries, so the hot keys fit but the cold ones are evicted
+ *
+ * - One shard (a single lock) vs 16 and 64 shards
+ * - LRU vs CLOCK
+ *
+ * - Afterwards no cache may hold more than its capacity
+ *      */
+
+constexpr std::size_t capacity = 4096;
+
+using lru_cache = concurrent_lru_cache<unsigned, unsigned long long>;
+using clock_cache = concurrent_lru_cache<unsigned, unsigned long long, eviction_policy::clock>;
+
+lru_cache lru_1(capacity, 1), lru_16(capacity, 16), lru_64(capacity, 64);
+clock_cache clock_1(capacity, 1), clock_16(capacity, 16), clock_64(capacity, 64);
+
+unsigned next_key(std::minstd_rand &rng)
+{
+    return rng() % 10 != 0 ? unsigned(rng() % 2048) : unsigned(rng() % 65536);
+}
+
+template<typename Cache>
+void add_cache_bench(const char *name, Cache &cache)
+{
+    bench::add(name, [&cache](bench::context &ctx) {
+        thread_local std::minstd_rand rng(ctx.thread_index + 1);
+        auto key = next_key(rng);
+        bench::do_not_optimize(cache.get_or_compute(key, [key] { return 3ULL * key; }));
+    }).threads_range(2 * bench::hardware_threads());
+}
+
+template<typename Cache>
+bool check(const char *name, const Cache &cache)
+{
+    auto n = cache.size();
+    if (n > cache.capacity())
+        std::printf("%s: %zu entries, capacity %zu\n", name, n, cache.capacity());
+    return n <= cache.capacity();
+}
+
+int main(int argc, char *argv[])
+{
+    add_cache_bench("lru/1_shard", lru_1);
+    add_cache_bench("lru/16_shards", lru_16);
+    add_cache_bench("lru/64_shards", lru_64);
+    add_cache_bench("clock/1_shard", clock_1);
+    add_cache_bench("clock/16_shards", clock_16);
+    add_cache_bench("clock/64_shards", clock_64);
+
+    int result = bench::run(argc, argv);
+
+    bool ok = check("lru/1_shard", lru_1) && check("lru/16_shards", lru_16) && check("lru/64_shards", lru_64)
+              && check("clock/1_shard", clock_1) && check("clock/16_shards", clock_16)
+              && check("clock/64_shards", clock_64);
+    return ok ? result : 1;
+}
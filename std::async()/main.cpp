@@ -2,6 +2,9 @@
 #include <future>
 #include <iostream>
 #include <chrono>
+#include "memo_async.h"
+#include "expected_async.h"
+#include "concurrent_lru_cache.h"
 
 /*
  * std::async()
@@ -131,6 +134,24 @@ int produce()
     std::cout << "Produce returning " << x << std::endl;
     return x;
 }
+
+// Same task, but the error is returned as a value instead of thrown
+enum class produce_error { out_of_range };
+
+std::expected<int, produce_error> produce_checked()
+{
+    int x = 42;
+
+    using namespace std::literals;
+    std::this_thread::sleep_for(2s);
+
+    if (1) {
+        return std::unexpected(produce_error::out_of_range);
+    }
+
+    std::cout << "Produce returning " << x << std::endl;
+    return x;
+}
 int main() {
 //    std::cout << "Hello, World!" << std::endl;
 //
@@ -170,5 +191,31 @@ int main() {
         std::cout << "Exception caught: " << e.what() << std::endl;
 
     }
+
+    // Memoized version - the second call joins the first one instead of recomputing
+    std::cout << "Calling memo_async(fibonacci, 44) twice" << std::endl;
+    auto memo1 = memo_async(fibonacci, 44);
+    auto memo2 = memo_async(fibonacci, 44);
+    std::cout << memo1.get() << " " << memo2.get() << std::endl;
+
+    // Completed results come straight from the cache
+    std::cout << memo_async(fibonacci, 44).get() << std::endl;
+    std::cout << "Cache hits: " << memo_cache<unsigned long long, unsigned long long>::instance().hits() << std::endl;
+
+    // Keep results after get() in a bounded, sharded cache
+    concurrent_lru_cache<unsigned long long, unsigned long long> results(1024);
+    for (int i = 0; i < 2; ++i) {
+        auto r = results.get_or_compute(40, [] { return std::async(fibonacci, 40).get(); });
+        std::cout << "fibonacci(40) = " << r << ", cached entries: " << results.size() << std::endl;
+    }
+
+    // The error comes back as a value - no try/catch needed
+    auto result2 = expected_async(produce_checked);
+    if (auto x = result2.get(); x) {
+        std::cout << "The answer is " << *x << std::endl;
+    }
+    else {
+        std::cout << "Error returned: out_of_range" << std::endl;
+    }
     return 0;
 }
@@ -0,0 +1,234 @@
+#ifndef MEMO_ASYNC_H
+#define MEMO_ASYNC_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Memoizing std::async()
+ *
+ * - std::async(fibonacci, 44) recomputes the result every time it is called
+ * - memo_async(fibonacci, 44) looks the call up in a cache first
+ *      - The key is the task function plus its arguments
+ *
+ * - Request coalescing
+ *      - If an identical call is still running, we get the same std::shared_future
+ *      - Only one thread does the work, every caller receives the result
+ *
+ * - A miss puts a std::packaged_task's future in the cache, then starts the thread
+ *   after releasing the lock
+ *      - Lookups never wait behind another call's thread creation
+ *      - The thread is detached: unlike std::async(), dropping the last future never
+ *        waits for the task
+ *
+ * - The cache is split into shards by key hash, each with its own lock, map and LRU list
+ *      - Calls with different keys usually use different shards
+ *
+ * - Completed results stay in a bounded cache
+ *      - The least recently used completed entry of a shard is evicted when the shard is full
+ *      - A task which is still running is never evicted, so a shard may go over
+ *        its capacity until it completes
+ *      - A task which throws is not cached: the callers already waiting see the
+ *        exception, the next call runs the task again
+ *      */
+
+// Combine the hashes of the function pointer and each argument
+template<typename Key>
+struct memo_key_hash {
+    std::size_t operator()(const Key &key) const
+    {
+        return std::apply([](const auto &...parts) {
+            std::size_t seed = 0;
+            ((seed ^= std::hash<std::decay_t<decltype(parts)>>{}(parts)
+                    + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)), ...);
+            return seed;
+        }, key);
+    }
+};
+
+template<typename R, typename... Params>
+class memo_cache {
+public:
+    using function = R (*)(Params...);
+    using key_type = std::tuple<function, std::decay_t<Params>...>;
+
+    explicit memo_cache(std::size_t capacity = 1024, std::size_t n_shards = 16)
+        : shards(round_up_pow2(n_shards))
+    {
+        set_capacity(capacity);
+    }
+
+    memo_cache(const memo_cache &) = delete;
+    memo_cache &operator=(const memo_cache &) = delete;
+
+    std::shared_future<R> get_or_launch(function f, std::decay_t<Params>... args)
+    {
+        key_type key(f, args...);
+        auto &s = shard_for(key);
+        std::shared_ptr<std::atomic<bool>> failed;
+        std::packaged_task<R()> task;
+        std::shared_future<R> result;
+        {
+            std::lock_guard<std::mutex> lg(s.mut);
+
+            auto it = s.entries.find(key);
+            if (it != s.entries.end()) {
+                // Hit - either in flight (coalesce) or completed
+                // A task which threw but is not quite finished still counts as in flight
+                if (!it->second.failed->load(std::memory_order_acquire) || !ready(it->second.result)) {
+                    s.lru.splice(s.lru.begin(), s.lru, it->second.position);
+                    ++s.hits;
+                    return it->second.result;
+                }
+                // The previous call threw - forget it and run the task again
+                s.lru.erase(it->second.position);
+                s.entries.erase(it);
+            }
+
+            // Miss - the entry goes in now, so identical calls coalesce onto it straight away
+            ++s.misses;
+            failed = std::make_shared<std::atomic<bool>>(false);
+            task = std::packaged_task<R()>([f, failed, args...]() -> R {
+                try {
+                    return f(args...);
+                }
+                catch (...) {
+                    failed->store(true, std::memory_order_release);
+                    throw;
+                }
+            });
+            result = task.get_future().share();
+
+            s.lru.push_front(key);
+            s.entries.emplace(std::move(key), entry{result, failed, s.lru.begin()});
+            s.evict();
+        }
+
+        // Start the thread without holding the lock
+        try {
+            std::thread(std::move(task)).detach();
+        }
+        catch (...) {
+            // No thread - the callers see std::future_error, and the next call tries again
+            failed->store(true, std::memory_order_release);
+            throw;
+        }
+        return result;
+    }
+
+    // Each shard holds capacity / shards entries (rounded up)
+    void set_capacity(std::size_t n)
+    {
+        auto per_shard = (n + shards.size() - 1) / shards.size();
+        for (auto &s : shards) {
+            std::lock_guard<std::mutex> lg(s.mut);
+            s.capacity = per_shard > 0 ? per_shard : 1;
+            s.evict();
+        }
+    }
+
+    std::size_t size() const { return sum(&shard::size); }
+    std::size_t hits() const { return sum(&shard::hits); }
+    std::size_t misses() const { return sum(&shard::misses); }
+
+    // One cache for each task signature
+    static memo_cache &instance()
+    {
+        static memo_cache cache;
+        return cache;
+    }
+
+private:
+    struct entry {
+        std::shared_future<R> result;
+        std::shared_ptr<std::atomic<bool>> failed;
+        typename std::list<key_type>::iterator position;
+    };
+
+    static bool ready(const std::shared_future<R> &result)
+    {
+        return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // Own cache line, so threads using neighbouring shards do not contend
+    struct alignas(64) shard {
+        mutable std::mutex mut;
+        std::size_t capacity = 1;
+        std::unordered_map<key_type, entry, memo_key_hash<key_type>> entries;
+        std::list<key_type> lru;            // Most recently used at the front
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+
+        std::size_t size() const noexcept { return entries.size(); }
+
+        // Called with the mutex held: evict completed entries, least recently used first,
+        // until the shard is within its capacity
+        // A running task is skipped, so that identical calls still coalesce onto it
+        void evict()
+        {
+            auto it = lru.end();
+            while (entries.size() > capacity && it != lru.begin()) {
+                --it;
+                auto victim = entries.find(*it);
+                if (!ready(victim->second.result))
+                    continue;
+                entries.erase(victim);
+                it = lru.erase(it);
+            }
+        }
+    };
+
+    static std::size_t round_up_pow2(std::size_t n) noexcept
+    {
+        std::size_t p = 1;
+        while (p < n)
+            p *= 2;
+        return p;
+    }
+
+    shard &shard_for(const key_type &key)
+    {
+        // Use the high bits of a mixed hash - the shard's map uses the low bits of the plain hash
+        std::uint64_t h = memo_key_hash<key_type>{}(key);
+        h *= 0x9e3779b97f4a7c15ULL;
+        return shards[(h >> 32) & (shards.size() - 1)];
+    }
+
+    template<typename Count>
+    std::size_t sum(Count count) const
+    {
+        std::size_t n = 0;
+        for (auto &s : shards) {
+            std::lock_guard<std::mutex> lg(s.mut);
+            n += std::invoke(count, s);
+        }
+        return n;
+    }
+
+    std::vector<shard> shards;
+};
+
+// Same syntax as std::async(), but the task function must be a plain function
+// so that it can be used as part of the cache key
+template<typename R, typename... Params, typename... Args>
+std::shared_future<R> memo_async(R (*f)(Params...), Args &&...args)
+{
+    static_assert(sizeof...(Params) == sizeof...(Args), "wrong number of arguments");
+    return memo_cache<R, Params...>::instance().get_or_launch(
+            f, static_cast<std::decay_t<Params>>(std::forward<Args>(args))...);
+}
+
+#endif //MEMO_ASYNC_H
@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include "memo_async.h"
+#include "benchmark.h"
+
+/*
+ * memo_async() vs std::async()
+ *
+ * - std::async(): every call runs the task in a new thread
+ * - memo_async() hit: the result is already in the cache
+ * - memo_async() miss: every call uses a new key, so a cheap task runs and an entry is evicted
+ * - memo_async() hit_with_misses: thread 0 misses, every other thread hits
+ *      - Hits must not wait behind the misses' thread creation
+ *
+ * - Check first: a full cache must not make memo_async() wait for a task that is still running
+ *      */
+
+using namespace std::literals;
+
+unsigned long long fibonacci(unsigned long long n)
+{
+    if (n <= 1)
+        return 1;
+    return fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+unsigned long long square(unsigned long long n)
+{
+    return n * n;
+}
+
+int slow(int n)
+{
+    std::this_thread::sleep_for(500ms);
+    return n;
+}
+
+// Capacity 1 in one shard, with a slow task in flight whose future has been discarded
+bool check()
+{
+    memo_cache<int, int> cache(1, 1);
+    cache.get_or_launch(slow, 1);
+    auto begin = std::chrono::steady_clock::now();
+    auto second = cache.get_or_launch(slow, 2);
+    auto launch = std::chrono::steady_clock::now() - begin;
+    bool ok = launch < 100ms && second.get() == 2;
+
+    // Once both have completed the cache is back within its capacity
+    cache.get_or_launch(slow, 1).get();
+    cache.get_or_launch(slow, 3).get();
+    return ok && cache.size() == 1 && cache.hits() == 1 && cache.misses() == 3;
+}
+
+int main(int argc, char *argv[])
+{
+    if (!check()) {
+        std::printf("check: FAILED\n");
+        return 1;
+    }
+    std::printf("check: ok\n");
+
+    bench::add("std_async", [](bench::context &) {
+        bench::do_not_optimize(std::async(std::launch::async, fibonacci, 20).get());
+    });
+
+    memo_async(fibonacci, 20).get();
+    bench::add("memo_async/hit", [](bench::context &) {
+        bench::do_not_optimize(memo_async(fibonacci, 20).get());
+    }).threads_range(bench::hardware_threads());
+
+    bench::add("memo_async/miss", [](bench::context &) {
+        static std::atomic<unsigned long long> key{0};
+        bench::do_not_optimize(memo_async(square, key++).get());
+    });
+
+    bench::add("memo_async/hit_with_misses", [](bench::context &ctx) {
+        static std::atomic<unsigned long long> key{1ULL << 32};
+        if (ctx.thread_index == 0)
+            bench::do_not_optimize(memo_async(square, key++).get());
+        else
+            bench::do_not_optimize(memo_async(fibonacci, 20).get());
+    }).threads({2, 4, 8, 16});
+
+    return bench::run(argc, argv);
+}